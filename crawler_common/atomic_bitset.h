@@ -0,0 +1,95 @@
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+// Growable concurrent bitset indexed by node ID (see intern_table.h), for visited sets.
+// test_and_set is a single atomic fetch_or, so marking a node visited needs no lock, and of several threads
+// setting the same bit exactly one sees it was clear. Bits live in segments of 2^18 that are allocated the
+// first time a bit in them is set, so the bitset can cover the whole uint32_t range without reserving it
+
+class AtomicBitset {
+    static const uint32_t SEGMENT_BITS = 18;
+    static const uint32_t SEGMENT_WORDS = (1u << SEGMENT_BITS) / 64;
+    static const uint32_t MAX_SEGMENTS = 1u << (32 - SEGMENT_BITS);
+
+    std::unique_ptr<std::atomic<std::atomic<uint64_t>*>[]> segments;
+    std::mutex grow_mutex;
+
+    std::atomic<uint64_t>* segment(uint32_t s) {
+        std::atomic<uint64_t>* seg = segments[s].load(std::memory_order_acquire);
+        if(seg) return seg;
+        std::lock_guard<std::mutex> lg(grow_mutex);
+        seg = segments[s].load(std::memory_order_acquire);
+        if(!seg) {
+            seg = new std::atomic<uint64_t>[SEGMENT_WORDS];
+            for(uint32_t w = 0; w < SEGMENT_WORDS; w++) seg[w].store(0, std::memory_order_relaxed);
+            segments[s].store(seg, std::memory_order_release);
+        }
+        return seg;
+    }
+
+    public:
+
+    AtomicBitset() : segments(new std::atomic<std::atomic<uint64_t>*>[MAX_SEGMENTS]) {
+        for(uint32_t s = 0; s < MAX_SEGMENTS; s++) {
+            segments[s].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~AtomicBitset() {
+        for(uint32_t s = 0; s < MAX_SEGMENTS; s++) {
+            delete[] segments[s].load(std::memory_order_relaxed);
+        }
+    }
+
+    AtomicBitset(const AtomicBitset&) = delete;
+    AtomicBitset& operator=(const AtomicBitset&) = delete;
+
+    // Sets bit i and returns its previous value
+    bool test_and_set(uint32_t i) {
+        std::atomic<uint64_t>& word = segment(i >> SEGMENT_BITS)[(i >> 6) & (SEGMENT_WORDS - 1)];
+        uint64_t bit = uint64_t(1) << (i & 63);
+        //skip the read-modify-write when the bit is already set, the common case for popular nodes
+        if(word.load(std::memory_order_relaxed) & bit) return true;
+        return word.fetch_or(bit, std::memory_order_acq_rel) & bit;
+    }
+
+    bool test(uint32_t i) const {
+        std::atomic<uint64_t>* seg = segments[i >> SEGMENT_BITS].load(std::memory_order_acquire);
+        if(!seg) return false;
+        return seg[(i >> 6) & (SEGMENT_WORDS - 1)].load(std::memory_order_relaxed) & (uint64_t(1) << (i & 63));
+    }
+
+    // Calls f(i) for every set bit, in increasing order. Bits set concurrently may or may not be seen
+    template <typename F>
+    void for_each(F f) const {
+        for(uint32_t s = 0; s < MAX_SEGMENTS; s++) {
+            std::atomic<uint64_t>* seg = segments[s].load(std::memory_order_acquire);
+            if(!seg) continue;
+            for(uint32_t w = 0; w < SEGMENT_WORDS; w++) {
+                uint64_t bits = seg[w].load(std::memory_order_relaxed);
+                while(bits) {
+                    uint32_t b = uint32_t(__builtin_ctzll(bits));
+                    f((s << SEGMENT_BITS) | (w << 6) | b);
+                    bits &= bits - 1;
+                }
+            }
+        }
+    }
+
+    size_t count() const {
+        size_t total = 0;
+        for(uint32_t s = 0; s < MAX_SEGMENTS; s++) {
+            std::atomic<uint64_t>* seg = segments[s].load(std::memory_order_acquire);
+            if(!seg) continue;
+            for(uint32_t w = 0; w < SEGMENT_WORDS; w++) {
+                total += __builtin_popcountll(seg[w].load(std::memory_order_relaxed));
+            }
+        }
+        return total;
+    }
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+// Growable concurrent array of BFS depths indexed by node ID (see intern_table.h), for crawls that do not
+// run level by level. relax() only ever lowers a node's depth, with a CAS loop, so when several threads find
+// the same node over paths of different lengths the shortest one wins and exactly one thread is told about
+// each improvement. Depths are one byte, UNREACHED until first set. Segments are allocated on first use like
+// AtomicBitset's
+
+class AtomicDepths {
+    static const uint32_t SEGMENT_BITS = 16;
+    static const uint32_t SEGMENT_SIZE = 1u << SEGMENT_BITS;
+    static const uint32_t MAX_SEGMENTS = 1u << (32 - SEGMENT_BITS);
+
+    std::unique_ptr<std::atomic<std::atomic<uint8_t>*>[]> segments;
+    std::mutex grow_mutex;
+
+    std::atomic<uint8_t>* segment(uint32_t s) {
+        std::atomic<uint8_t>* seg = segments[s].load(std::memory_order_acquire);
+        if(seg) return seg;
+        std::lock_guard<std::mutex> lg(grow_mutex);
+        seg = segments[s].load(std::memory_order_acquire);
+        if(!seg) {
+            seg = new std::atomic<uint8_t>[SEGMENT_SIZE];
+            for(uint32_t i = 0; i < SEGMENT_SIZE; i++) seg[i].store(UNREACHED, std::memory_order_relaxed);
+            segments[s].store(seg, std::memory_order_release);
+        }
+        return seg;
+    }
+
+    public:
+
+    static const uint8_t UNREACHED = 255;
+
+    AtomicDepths() : segments(new std::atomic<std::atomic<uint8_t>*>[MAX_SEGMENTS]) {
+        for(uint32_t s = 0; s < MAX_SEGMENTS; s++) {
+            segments[s].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~AtomicDepths() {
+        for(uint32_t s = 0; s < MAX_SEGMENTS; s++) {
+            delete[] segments[s].load(std::memory_order_relaxed);
+        }
+    }
+
+    AtomicDepths(const AtomicDepths&) = delete;
+    AtomicDepths& operator=(const AtomicDepths&) = delete;
+
+    // Lowers node i's depth to depth. Returns true if depth was smaller than the node's depth so far,
+    // including when the node had none
+    bool relax(uint32_t i, uint8_t depth) {
+        std::atomic<uint8_t>& d = segment(i >> SEGMENT_BITS)[i & (SEGMENT_SIZE - 1)];
+        uint8_t current = d.load(std::memory_order_relaxed);
+        while(depth < current) {
+            if(d.compare_exchange_weak(current, depth, std::memory_order_acq_rel, std::memory_order_relaxed)) return true;
+        }
+        return false;
+    }
+
+    uint8_t get(uint32_t i) const {
+        std::atomic<uint8_t>* seg = segments[i >> SEGMENT_BITS].load(std::memory_order_acquire);
+        if(!seg) return UNREACHED;
+        return seg[i & (SEGMENT_SIZE - 1)].load(std::memory_order_acquire);
+    }
+};
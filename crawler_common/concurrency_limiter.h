@@ -0,0 +1,249 @@
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cmath>
+
+// Limits how many requests the crawler has open at once, and optionally how many it starts per second.
+// The thread count is only the ceiling: each request takes a permit first, and with --adaptive the number of
+// permits moves with the service's behaviour, AIMD style as in TCP congestion control:
+// - it starts at 1 and grows by one per completed request (doubling per round trip) until the first back-off,
+//   then by one per round trip, as long as requests succeed without a latency spike
+// - a latency spike, or a failed request (curl error, 429 or 5xx) while more than ERROR_TOLERANCE of recent
+//   requests failed, halves it. Only requests started after the last cut can cut it again, so one overload
+//   counts once, and the odd failure of a healthy server does not count at all
+// A spike is a request slower than LATENCY_TOLERANCE times the long-term latency while the moving average of
+// the last few requests is above that too, so jitter on single requests does not count. The long-term latency
+// averages over LONG_TERM_SECONDS, so queues that build up within a few round trips stand out against it, while
+// a server that gets slower for good is followed instead of cutting the limit forever.
+// --max-rate adds a token bucket: requests start at most that many times per second, in bursts of up to a tenth
+// of a second's worth. Without --adaptive the limit stays at the thread count and only the rate cap applies
+
+struct LimiterOptions {
+    bool adaptive = false;
+    double max_rate = 0;    //requests per second, 0: no cap
+};
+
+inline const char* LIMITER_OPTIONS_USAGE =
+    "  --adaptive          adjust the number of requests in flight to the service's latency and errors, up to\n"
+    "                      one per thread\n"
+    "  --max-rate R        start at most R requests per second\n";
+
+// Parses the limiter option at argv[i], moving i past its value. Returns false if argv[i] is not a limiter option
+inline bool parse_limiter_option(int argc, char* argv[], int& i, LimiterOptions& opts) {
+    std::string flag = argv[i];
+    if (flag == "--adaptive") {
+        opts.adaptive = true;
+        return true;
+    }
+    if (flag != "--max-rate") return false;
+    if (i + 1 >= argc) throw std::invalid_argument(flag + " needs a value");
+    opts.max_rate = std::stod(argv[++i]);
+    if (opts.max_rate <= 0) throw std::invalid_argument("--max-rate must be positive");
+    return true;
+}
+
+class ConcurrencyLimiter {
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr double LATENCY_TOLERANCE = 2.0;
+    static constexpr double LATENCY_SMOOTHING = 0.05;   //weight of a new sample in the moving average
+    static constexpr double LONG_TERM_SECONDS = 10;
+    static constexpr uint64_t WARMUP = 20;              //requests, see finished()
+    static constexpr double ERROR_SMOOTHING = 0.02;
+    static constexpr double ERROR_TOLERANCE = 0.1;
+    static constexpr double BACKOFF = 0.5;
+    static constexpr double REPORT_INTERVAL = 0.5;      //seconds per line of the report
+
+    // What happened during one interval of the crawl
+    struct Interval {
+        double limit = 0;           //at the end of the interval
+        uint64_t requests = 0;
+        uint64_t errors = 0;
+        uint64_t spikes = 0;
+        double latency_sum = 0;
+        int max_in_flight = 0;
+    };
+
+    LimiterOptions opts;
+    double max_limit;
+    Clock::time_point start = Clock::now();
+
+    std::mutex mut;
+    std::condition_variable slot_free;
+    double limit;
+    bool slow_start = true;
+    int in_flight = 0;
+    double average_latency = 0;
+    double long_term_latency = 0;
+    Clock::time_point last_success = start;
+    uint64_t successes = 0;
+    double error_rate = 0;
+    Clock::time_point last_cut = start;
+    double tokens;
+    Clock::time_point last_refill = start;
+
+    uint64_t cuts = 0;
+    std::vector<Interval> intervals;
+
+    double seconds(Clock::time_point t) const {
+        return std::chrono::duration<double>(t - start).count();
+    }
+
+    Interval& interval(Clock::time_point t) {
+        size_t i = size_t(seconds(t) / REPORT_INTERVAL);
+        while (intervals.size() <= i) {
+            Interval next;
+            next.limit = limit;
+            intervals.push_back(next);
+        }
+        return intervals[i];
+    }
+
+    void refill(Clock::time_point now) {
+        tokens = std::min(bucket_size(), tokens + std::chrono::duration<double>(now - last_refill).count() * opts.max_rate);
+        last_refill = now;
+    }
+
+    double bucket_size() const {
+        return std::max(1.0, opts.max_rate / 10);
+    }
+
+    public:
+
+    // Up to max_concurrency requests in flight, one per thread
+    ConcurrencyLimiter(const LimiterOptions& options, int max_concurrency)
+        : opts(options), max_limit(std::max(1, max_concurrency)) {
+        limit = opts.adaptive ? 1 : max_limit;
+        tokens = bucket_size();
+    }
+
+    ConcurrencyLimiter(const ConcurrencyLimiter&) = delete;
+    ConcurrencyLimiter& operator=(const ConcurrencyLimiter&) = delete;
+
+    // Blocks until a request may start. Returns when it started, for finished()
+    Clock::time_point acquire() {
+        std::unique_lock<std::mutex> lg(mut);
+        while (true) {
+            if (in_flight < int(limit)) {
+                if (opts.max_rate <= 0)
+                    break;
+                Clock::time_point now = Clock::now();
+                refill(now);
+                if (tokens >= 1) {
+                    tokens -= 1;
+                    break;
+                }
+                //wakes up early if a permit is handed back, which is harmless
+                slot_free.wait_for(lg, std::chrono::duration<double>((1 - tokens) / opts.max_rate));
+            } else {
+                slot_free.wait(lg);
+            }
+        }
+        in_flight++;
+        Clock::time_point now = Clock::now();
+        Interval& current = interval(now);
+        current.max_in_flight = std::max(current.max_in_flight, in_flight);
+        return now;
+    }
+
+    // Hands back the permit of a request that started at started, and adjusts the limit to how it went
+    void finished(Clock::time_point started, bool ok) {
+        Clock::time_point now = Clock::now();
+        double latency = std::chrono::duration<double>(now - started).count();
+
+        std::lock_guard<std::mutex> lg(mut);
+        in_flight--;
+        error_rate += ERROR_SMOOTHING * ((ok ? 0 : 1) - error_rate);
+        if (ok) {
+            successes++;
+            average_latency += std::max(LATENCY_SMOOTHING, 1.0 / successes) * (latency - average_latency);
+            //weighted by time rather than per request, so the window does not depend on the request rate. It
+            //starts as the plain mean of the first requests, which slow start sends while few are in flight
+            double weight = 1 - std::exp(-std::chrono::duration<double>(now - last_success).count() / LONG_TERM_SECONDS);
+            if (successes <= WARMUP)
+                weight = 1.0 / successes;
+            long_term_latency += weight * (latency - long_term_latency);
+            last_success = now;
+        }
+        double threshold = LATENCY_TOLERANCE * long_term_latency;
+        bool spike = ok && latency > threshold && average_latency > threshold;
+
+        if (opts.adaptive) {
+            if ((!ok && error_rate > ERROR_TOLERANCE) || spike) {
+                if (started >= last_cut) {
+                    limit = std::max(1.0, limit * BACKOFF);
+                    slow_start = false;
+                    last_cut = now;
+                    cuts++;
+                }
+            } else if (int(limit) <= in_flight + 1) {
+                //only grow while the limit is what holds the crawl back, not the number of nodes to expand
+                limit = std::min(max_limit, limit + (slow_start ? 1 : 1 / limit));
+            }
+        }
+
+        Interval& current = interval(now);
+        current.requests++;
+        current.errors += !ok;
+        current.spikes += spike;
+        current.latency_sum += latency;
+        current.limit = limit;
+        //the limit may have grown by more than the one permit handed back
+        slot_free.notify_all();
+    }
+
+    // Takes a permit for the lifetime of the object. A request that ends without done(), e.g. by an
+    // exception, counts as failed
+    class Permit {
+        ConcurrencyLimiter* limiter;
+        Clock::time_point started;
+        bool ok = false;
+
+        public:
+
+        Permit(ConcurrencyLimiter* limiter) : limiter(limiter) {
+            if (limiter) started = limiter->acquire();
+        }
+
+        ~Permit() {
+            if (limiter) limiter->finished(started, ok);
+        }
+
+        Permit(const Permit&) = delete;
+        Permit& operator=(const Permit&) = delete;
+
+        void done(bool success) {
+            ok = success;
+        }
+    };
+
+    // The limit over time, one line per interval
+    void print_stats(std::ostream& out) {
+        std::lock_guard<std::mutex> lg(mut);
+        uint64_t requests = 0, errors = 0;
+        out << "Concurrency over time:\n";
+        for (size_t i = 0; i < intervals.size(); i++) {
+            const Interval& s = intervals[i];
+            requests += s.requests;
+            errors += s.errors;
+            out << "  " << std::fixed << std::setprecision(1) << i * REPORT_INTERVAL << "s: limit " << s.limit
+                << ", up to " << s.max_in_flight << " in flight, " << s.requests << " requests";
+            if (s.requests > 0)
+                out << ", " << std::setprecision(1) << 1000 * s.latency_sum / s.requests << "ms mean latency";
+            out << ", " << s.errors << " errors, " << s.spikes << " latency spikes\n";
+            out.unsetf(std::ios::floatfield);
+            out << std::setprecision(6);
+        }
+        out << "Concurrency: " << requests << " requests, " << errors << " errors, " << cuts << " cuts, final limit "
+            << limit << " of " << max_limit << "\n";
+    }
+};
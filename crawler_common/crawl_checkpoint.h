@@ -0,0 +1,203 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "intern_table.h"
+
+// Checkpoints of a level by level crawl, so a crawl that crashes or runs out of time can pick up where it was.
+// A checkpoint holds the levels expanded so far, the level being expanded with how many of its nodes are done,
+// and the nodes those found for the next level. The visited set is not stored: in a level by level crawl it is
+// exactly the nodes of all those lists.
+// The file is binary, names stored once each as (uint32_t length, bytes):
+//     magic, start node, level count, per level (count, names), frontier (count, names), expanded count,
+//     found (count, names), end marker
+// The frontier is stored with its expanded nodes first, so the expanded ones are a prefix and only need a count.
+// Checkpoints are written to FILE.tmp, synced and renamed over FILE, so a crash while writing leaves the
+// previous checkpoint intact
+
+struct CheckpointOptions {
+    std::string path;           //empty: no checkpoints
+    double interval = 60;       //seconds between checkpoints within a level
+    bool resume = false;
+};
+
+inline const char* CHECKPOINT_OPTIONS_USAGE =
+    "  --checkpoint FILE   save the crawl's progress to FILE after every level and during long levels\n"
+    "  --checkpoint-interval SEC\n"
+    "                      save progress within a level every SEC seconds (default 60)\n"
+    "  --resume            continue from the checkpoint in FILE if there is one, without refetching expanded nodes\n";
+
+// Parses the checkpoint option at argv[i], moving i past its value. Returns false if argv[i] is not a checkpoint option
+inline bool parse_checkpoint_option(int argc, char* argv[], int& i, CheckpointOptions& opts) {
+    std::string flag = argv[i];
+    if (flag == "--resume") {
+        opts.resume = true;
+        return true;
+    }
+    if (flag != "--checkpoint" && flag != "--checkpoint-interval") return false;
+    if (i + 1 >= argc) throw std::invalid_argument(flag + " needs a value");
+    std::string value = argv[++i];
+    if (flag == "--checkpoint") opts.path = value;
+    else opts.interval = std::stod(value);
+    if (opts.interval <= 0) throw std::invalid_argument("--checkpoint-interval must be positive");
+    return true;
+}
+
+// Where a level by level crawl is
+struct CrawlProgress {
+    std::string start;
+    std::vector<std::vector<uint32_t>> levels;  //fully expanded
+    std::vector<uint32_t> frontier;             //the level after them, its first `expanded` nodes are expanded
+    size_t expanded = 0;
+    std::vector<uint32_t> found;                //next level nodes found by the expanded ones
+};
+
+class CheckpointFile {
+    static const uint64_t MAGIC = 0x3154504b43474848ULL;   //"HHGCKPT1"
+    static const uint64_t END = 0x444e45544e494f50ULL;     //"POINTEND"
+
+    std::string path;
+    std::string buffer;
+
+    void put_u64(uint64_t x) {
+        buffer.append((const char*)&x, sizeof(x));
+    }
+
+    void put_name(std::string_view s) {
+        uint32_t len = s.size();
+        buffer.append((const char*)&len, sizeof(len));
+        buffer.append(s.data(), s.size());
+    }
+
+    void put_list(InternTable& names, const std::vector<uint32_t>& ids) {
+        put_u64(ids.size());
+        for (uint32_t id : ids) {
+            put_name(names.name(id));
+        }
+    }
+
+    // Reads from a loaded file, throwing if it ends early
+    struct Reader {
+        const std::string& data;
+        const std::string& path;
+        size_t pos = 0;
+
+        void need(size_t n) {
+            if (data.size() - pos < n) throw std::runtime_error("Checkpoint " + path + " is truncated");
+        }
+
+        uint64_t u64() {
+            need(sizeof(uint64_t));
+            uint64_t x;
+            std::memcpy(&x, data.data() + pos, sizeof(x));
+            pos += sizeof(x);
+            return x;
+        }
+
+        std::string_view name() {
+            need(sizeof(uint32_t));
+            uint32_t len;
+            std::memcpy(&len, data.data() + pos, sizeof(len));
+            pos += sizeof(len);
+            need(len);
+            std::string_view s(data.data() + pos, len);
+            pos += len;
+            return s;
+        }
+
+        std::vector<uint32_t> list(InternTable& names) {
+            uint64_t n = u64();
+            std::vector<uint32_t> ids;
+            ids.reserve(std::min<uint64_t>(n, data.size() / sizeof(uint32_t)));
+            for (uint64_t i = 0; i < n; i++) {
+                ids.push_back(names.intern(name()));
+            }
+            return ids;
+        }
+    };
+
+    public:
+
+    CheckpointFile(const std::string& path) : path(path) {
+    }
+
+    bool exists() const {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0;
+    }
+
+    // Replaces the checkpoint with the first done_levels of levels, then frontier with its first expanded nodes
+    // expanded, then found, as load() returns them. Node IDs are looked up in names
+    void save(InternTable& names, const std::string& start, const std::vector<std::vector<uint32_t>>& levels, size_t done_levels,
+              const std::vector<uint32_t>& frontier, size_t expanded, const std::vector<uint32_t>& found) {
+        buffer.clear();
+        put_u64(MAGIC);
+        put_name(start);
+        put_u64(done_levels);
+        for (size_t i = 0; i < done_levels; i++) {
+            put_list(names, levels[i]);
+        }
+        put_list(names, frontier);
+        put_u64(expanded);
+        put_list(names, found);
+        put_u64(END);
+
+        std::string tmp = path + ".tmp";
+        int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) throw std::runtime_error("Cannot write checkpoint " + tmp + ": " + std::strerror(errno));
+        size_t written = 0;
+        while (written < buffer.size()) {
+            ssize_t n = write(fd, buffer.data() + written, buffer.size() - written);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                close(fd);
+                throw std::runtime_error("Cannot write checkpoint " + tmp + ": " + std::strerror(errno));
+            }
+            written += n;
+        }
+        //the data must be on disk before the rename makes it the checkpoint
+        bool synced = fsync(fd) == 0;
+        close(fd);
+        if (!synced || std::rename(tmp.c_str(), path.c_str()) != 0)
+            throw std::runtime_error("Cannot replace checkpoint " + path + ": " + std::strerror(errno));
+    }
+
+    // Reads the checkpoint, interning its node names in names
+    CrawlProgress load(InternTable& names) {
+        std::string data;
+        FILE* f = std::fopen(path.c_str(), "rb");
+        if (!f) throw std::runtime_error("Cannot open checkpoint " + path + ": " + std::strerror(errno));
+        char chunk[1 << 16];
+        size_t n;
+        while ((n = std::fread(chunk, 1, sizeof(chunk), f)) > 0) {
+            data.append(chunk, n);
+        }
+        std::fclose(f);
+
+        Reader in{data, path};
+        if (in.u64() != MAGIC) throw std::runtime_error(path + " is not a crawl checkpoint");
+        CrawlProgress progress;
+        progress.start = in.name();
+        uint64_t levels = in.u64();
+        for (uint64_t i = 0; i < levels; i++) {
+            progress.levels.push_back(in.list(names));
+        }
+        progress.frontier = in.list(names);
+        progress.expanded = in.u64();
+        progress.found = in.list(names);
+        if (in.u64() != END || progress.expanded > progress.frontier.size())
+            throw std::runtime_error("Checkpoint " + path + " is corrupt");
+        return progress;
+    }
+};
@@ -0,0 +1,282 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "intern_table.h"
+
+// Crawled graphs in a binary compressed sparse row file, for analytics that should not parse crawler output.
+// Nodes are numbered 0 .. nodes-1 in name order. The file is a header, then
+// - offsets: uint64_t[nodes + 1], node v's neighbors are neighbors[offsets[v] .. offsets[v + 1])
+// - neighbors: uint32_t[edges], each list sorted. Every edge is stored in both directions
+// - the name dictionary, front coded in blocks of DICT_BLOCK names: uint64_t[blocks] offsets of the blocks
+//   into the dictionary bytes, then the bytes. A block's first name is stored whole as (varint length, bytes),
+//   every other name as (varint bytes shared with the previous name, varint length of the rest, the rest).
+//   Consecutive names in sorted order share long prefixes ("Actor 1234", "Actor 1235"), so this stores them
+//   in a fraction of their size, while a lookup only decodes one block
+// Sections start at multiples of 8 bytes, so CsrGraph can map the file and use the arrays where they are
+
+typedef std::vector<std::pair<uint32_t, uint32_t>> EdgeList;
+
+namespace csr_detail {
+
+const uint64_t MAGIC = 0x3130305253434748ULL;     //"HGCSR001"
+const uint32_t DICT_BLOCK = 16;
+
+struct Header {
+    uint64_t magic;
+    uint64_t nodes;
+    uint64_t edges;
+    uint64_t offsets_at;
+    uint64_t neighbors_at;
+    uint64_t blocks_at;
+    uint64_t dict_at;
+    uint64_t dict_bytes;
+};
+
+inline void put_varint(std::string& out, uint64_t x) {
+    while (x >= 0x80) {
+        out.push_back(char(0x80 | (x & 0x7f)));
+        x >>= 7;
+    }
+    out.push_back(char(x));
+}
+
+inline uint64_t get_varint(const unsigned char*& p) {
+    uint64_t x = 0;
+    for (int shift = 0; ; shift += 7) {
+        unsigned char b = *p++;
+        x |= uint64_t(b & 0x7f) << shift;
+        if (!(b & 0x80)) return x;
+    }
+}
+
+inline uint64_t align8(uint64_t x) {
+    return (x + 7) & ~uint64_t(7);
+}
+
+}
+
+// Writes the graph of nodes and edges to path. IDs are names' IDs; every edge end must be in nodes. Edges are
+// made undirected, and duplicates and self loops dropped
+inline void write_csr_graph(const std::string& path, InternTable& names, const std::vector<uint32_t>& nodes, const EdgeList& edges) {
+    using namespace csr_detail;
+    //renumber in name order, which the dictionary needs
+    std::vector<uint32_t> order(nodes);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return names.name(a) < names.name(b); });
+    order.erase(std::unique(order.begin(), order.end()), order.end());
+    std::vector<uint32_t> rank(names.size(), UINT32_MAX);
+    for (uint32_t i = 0; i < order.size(); i++) {
+        rank[order[i]] = i;
+    }
+    uint64_t n = order.size();
+
+    //counting sort of both directions of every edge into per-node lists, then each list sorted and deduplicated
+    std::vector<uint64_t> offsets(n + 1, 0);
+    for (const auto& [a, b] : edges) {
+        if (rank[a] == UINT32_MAX || rank[b] == UINT32_MAX)
+            throw std::invalid_argument("edge to a node that is not in the graph");
+        if (a == b) continue;
+        offsets[rank[a] + 1]++;
+        offsets[rank[b] + 1]++;
+    }
+    for (uint64_t v = 0; v < n; v++) {
+        offsets[v + 1] += offsets[v];
+    }
+    std::vector<uint32_t> neighbors(offsets[n]);
+    std::vector<uint64_t> fill(offsets.begin(), offsets.end() - 1);
+    for (const auto& [a, b] : edges) {
+        if (a == b) continue;
+        neighbors[fill[rank[a]]++] = rank[b];
+        neighbors[fill[rank[b]]++] = rank[a];
+    }
+    uint64_t kept = 0;
+    for (uint64_t v = 0; v < n; v++) {
+        auto first = neighbors.begin() + offsets[v], last = neighbors.begin() + offsets[v + 1];
+        std::sort(first, last);
+        last = std::unique(first, last);
+        uint64_t start = kept;
+        kept = std::move(first, last, neighbors.begin() + kept) - neighbors.begin();
+        offsets[v] = start;
+    }
+    offsets[n] = kept;
+    neighbors.resize(kept);
+
+    std::vector<uint64_t> blocks;
+    std::string dict;
+    std::string_view previous;
+    for (uint64_t v = 0; v < n; v++) {
+        std::string_view name = names.name(order[v]);
+        if (v % DICT_BLOCK == 0) {
+            blocks.push_back(dict.size());
+            put_varint(dict, name.size());
+            dict.append(name);
+        } else {
+            size_t shared = 0;
+            while (shared < name.size() && shared < previous.size() && name[shared] == previous[shared]) shared++;
+            put_varint(dict, shared);
+            put_varint(dict, name.size() - shared);
+            dict.append(name.substr(shared));
+        }
+        previous = name;
+    }
+
+    Header h;
+    h.magic = MAGIC;
+    h.nodes = n;
+    h.edges = neighbors.size();
+    h.offsets_at = align8(sizeof(Header));
+    h.neighbors_at = h.offsets_at + (n + 1) * sizeof(uint64_t);
+    h.blocks_at = align8(h.neighbors_at + neighbors.size() * sizeof(uint32_t));
+    h.dict_at = h.blocks_at + blocks.size() * sizeof(uint64_t);
+    h.dict_bytes = dict.size();
+
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) throw std::runtime_error("Cannot write " + path + ": " + std::strerror(errno));
+    const uint64_t zero = 0;
+    bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1
+        && std::fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), f) == offsets.size()
+        && std::fwrite(neighbors.data(), sizeof(uint32_t), neighbors.size(), f) == neighbors.size()
+        && std::fwrite(&zero, 1, h.blocks_at - (h.neighbors_at + neighbors.size() * sizeof(uint32_t)), f) == h.blocks_at - (h.neighbors_at + neighbors.size() * sizeof(uint32_t))
+        && std::fwrite(blocks.data(), sizeof(uint64_t), blocks.size(), f) == blocks.size()
+        && std::fwrite(dict.data(), 1, dict.size(), f) == dict.size();
+    if (std::fclose(f) != 0 || !ok)
+        throw std::runtime_error("Cannot write " + path + ": " + std::strerror(errno));
+}
+
+// A graph written by write_csr_graph, mapped read-only. Opening it only checks the header, nothing is parsed
+// or copied, and pages are read from disk as they are used
+class CsrGraph {
+    const char* base = nullptr;
+    size_t bytes = 0;
+    const csr_detail::Header* h = nullptr;
+    const uint64_t* offsets = nullptr;
+    const uint32_t* adjacency = nullptr;
+    const uint64_t* blocks = nullptr;
+    const unsigned char* dict = nullptr;
+
+    // Decodes names of block b in order, calling f(index in block, name) until it returns false
+    template <typename F>
+    void decode_block(uint64_t b, F f) const {
+        using namespace csr_detail;
+        const unsigned char* p = dict + blocks[b];
+        std::string name;
+        uint64_t count = std::min<uint64_t>(DICT_BLOCK, h->nodes - b * DICT_BLOCK);
+        for (uint64_t i = 0; i < count; i++) {
+            uint64_t shared = i == 0 ? 0 : get_varint(p);
+            uint64_t rest = get_varint(p);
+            name.resize(shared);
+            name.append((const char*)p, rest);
+            p += rest;
+            if (!f(i, name)) return;
+        }
+    }
+
+    public:
+
+    // A node's neighbor IDs, in increasing order
+    struct Neighbors {
+        const uint32_t* first;
+        const uint32_t* last;
+        const uint32_t* begin() const { return first; }
+        const uint32_t* end() const { return last; }
+        size_t size() const { return last - first; }
+    };
+
+    CsrGraph(const std::string& path) {
+        using namespace csr_detail;
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+        struct stat st;
+        fstat(fd, &st);
+        bytes = st.st_size;
+        void* m = bytes >= sizeof(Header) ? mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+        close(fd);
+        if (m == MAP_FAILED) throw std::runtime_error(path + " is not a CSR graph");
+        base = (const char*)m;
+        h = (const Header*)base;
+        bool valid = h->magic == MAGIC && h->offsets_at + (h->nodes + 1) * sizeof(uint64_t) <= bytes
+            && h->neighbors_at + h->edges * sizeof(uint32_t) <= bytes
+            && h->blocks_at + (h->nodes + DICT_BLOCK - 1) / DICT_BLOCK * sizeof(uint64_t) <= h->dict_at
+            && h->dict_at + h->dict_bytes <= bytes;
+        if (!valid) {
+            munmap(m, bytes);
+            throw std::runtime_error(path + " is not a CSR graph");
+        }
+        offsets = (const uint64_t*)(base + h->offsets_at);
+        adjacency = (const uint32_t*)(base + h->neighbors_at);
+        blocks = (const uint64_t*)(base + h->blocks_at);
+        dict = (const unsigned char*)(base + h->dict_at);
+    }
+
+    ~CsrGraph() {
+        munmap((void*)base, bytes);
+    }
+
+    CsrGraph(const CsrGraph&) = delete;
+    CsrGraph& operator=(const CsrGraph&) = delete;
+
+    uint32_t nodes() const {
+        return h->nodes;
+    }
+
+    // Both directions of every edge count
+    uint64_t edges() const {
+        return h->edges;
+    }
+
+    size_t degree(uint32_t v) const {
+        return offsets[v + 1] - offsets[v];
+    }
+
+    Neighbors neighbors(uint32_t v) const {
+        return Neighbors{adjacency + offsets[v], adjacency + offsets[v + 1]};
+    }
+
+    std::string name(uint32_t v) const {
+        std::string result;
+        decode_block(v / csr_detail::DICT_BLOCK, [&](uint64_t i, const std::string& name) {
+            if (i < v % csr_detail::DICT_BLOCK) return true;
+            result = name;
+            return false;
+        });
+        return result;
+    }
+
+    // Looks up a node by name. Returns false if there is none
+    bool find(std::string_view name, uint32_t& v) const {
+        using namespace csr_detail;
+        uint64_t n_blocks = (h->nodes + DICT_BLOCK - 1) / DICT_BLOCK;
+        //last block whose first name is at most name
+        uint64_t lo = 0, hi = n_blocks;
+        while (lo < hi) {
+            uint64_t mid = (lo + hi) / 2;
+            const unsigned char* p = dict + blocks[mid];
+            uint64_t len = get_varint(p);
+            if (std::string_view((const char*)p, len) <= name) lo = mid + 1;
+            else hi = mid;
+        }
+        if (lo == 0) return false;
+        bool found = false;
+        decode_block(lo - 1, [&](uint64_t i, const std::string& s) {
+            if (s == name) {
+                v = (lo - 1) * DICT_BLOCK + i;
+                found = true;
+            }
+            return !found && s < name;
+        });
+        return found;
+    }
+};
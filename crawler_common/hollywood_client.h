@@ -0,0 +1,179 @@
+#pragma once
+
+// Client for the Hollywood graph service, shared by the crawlers: URL encoding, fetching a node's
+// neighbors over HTTP with libcurl, and parsing the JSON response with rapidjson.
+// stream_neighbors() does the fetch and the parse in one pass, see neighbor_parser.h
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <curl/curl.h>
+#include <stdexcept>
+#include "rapidjson/error/error.h"
+#include "rapidjson/reader.h"
+
+
+struct ParseException : std::runtime_error, rapidjson::ParseResult {
+    ParseException(rapidjson::ParseErrorCode code, const char* msg, size_t offset) : 
+        std::runtime_error(msg), 
+        rapidjson::ParseResult(code, offset) {}
+};
+
+#define RAPIDJSON_PARSE_ERROR_NORETURN(code, offset) \
+    throw ParseException(code, #code, offset)
+
+#include <rapidjson/document.h>
+#include "neighbor_parser.h"
+#include "service_url.h"
+
+
+//each crawler defines its own debug flag
+extern bool debug;
+
+const std::string SERVICE_URL = service_url();
+
+// Function to HTTP ecnode parts of URLs. for instance, replace spaces with '%20' for URLs
+inline std::string url_encode(CURL* curl, std::string input) {
+  char* out = curl_easy_escape(curl, input.c_str(), input.size());
+  std::string s = out;
+  curl_free(out);
+  return s;
+}
+
+// Callback function for writing response data
+inline size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* output) {
+    size_t totalSize = size * nmemb;
+    output->append((char*)contents, totalSize);
+    return totalSize;
+}
+
+// Function to fetch neighbors using libcurl with debugging
+inline std::string fetch_neighbors(CURL* curl, const std::string& node) {
+
+  std::string url = SERVICE_URL + url_encode(curl, node);
+  std::string response;
+
+    if (debug)
+      std::cout << "Sending request to: " << url << std::endl;
+
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    // curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L); // Verbose Logging
+
+    // Set a User-Agent header to avoid potential blocking by the server
+    struct curl_slist* headers = nullptr;
+    headers = curl_slist_append(headers, "User-Agent: C++-Client/1.0");
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+
+    CURLcode res = curl_easy_perform(curl);
+
+    if (res != CURLE_OK) {
+      std::cerr << "CURL error: " << curl_easy_strerror(res) << std::endl;
+    } else {
+      if (debug)
+        std::cout << "CURL request successful!" << std::endl;
+    }
+
+    // Cleanup
+    curl_slist_free_all(headers);
+
+    if (debug) 
+      std::cout << "Response received: " << response << std::endl;  // Debug log
+
+    return (res == CURLE_OK) ? response : "{}";
+}
+
+// Function to parse JSON and extract neighbors
+inline std::vector<std::string> get_neighbors(const std::string& json_str) {
+    std::vector<std::string> neighbors;
+    try {
+      rapidjson::Document doc;
+      doc.Parse(json_str.c_str());
+      
+      if (doc.HasMember("neighbors") && doc["neighbors"].IsArray()) {
+        for (const auto& neighbor : doc["neighbors"].GetArray())
+	        neighbors.push_back(neighbor.GetString());
+      }
+    } catch (const ParseException& e) {
+      std::cerr<<"Error while parsing JSON: "<<json_str<<std::endl;
+      throw e;
+    }
+    return neighbors;
+}
+
+// Outcome of stream_neighbors()
+struct FetchResult {
+    CURLcode curl_code = CURLE_OK;
+    long http_code = 0;
+    size_t neighbors = 0;   //names passed to on_neighbor
+
+    bool ok() const {
+        return curl_code == CURLE_OK;
+    }
+
+    //the service is overloaded or failing, as opposed to not knowing the node
+    bool server_error() const {
+        return http_code == 429 || http_code >= 500;
+    }
+};
+
+template <typename Parser>
+size_t StreamCallback(void* contents, size_t size, size_t nmemb, Parser* parser) {
+    size_t totalSize = size * nmemb;
+    //returning less than totalSize makes curl abort the transfer with CURLE_WRITE_ERROR
+    return parser->feed((const char*)contents, totalSize) ? totalSize : 0;
+}
+
+// Sets up curl to request node's neighbors, with the body going to parser. Returns the header list, which the
+// caller frees once the transfer is over
+template <typename Parser>
+curl_slist* prepare_neighbors_request(CURL* curl, const std::string& node, Parser* parser) {
+    std::string url = SERVICE_URL + url_encode(curl, node);
+
+    if (debug)
+      std::cout << "Sending request to: " << url << std::endl;
+
+    //curl copies the URL
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, StreamCallback<Parser>);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, parser);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+
+    // Set a User-Agent header to avoid potential blocking by the server
+    struct curl_slist* headers = nullptr;
+    headers = curl_slist_append(headers, "User-Agent: C++-Client/1.0");
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    return headers;
+}
+
+// Fetches node's neighbors and calls on_neighbor(std::string_view) for each one while the response is still
+// arriving, with no body buffer, DOM or per-neighbor string. The view is only valid during the call.
+// A syntax error stops the transfer and is thrown as a ParseException once curl has returned, since
+// exceptions cannot unwind through curl. If the transfer itself fails, the names that arrived before the
+// failure have already been passed on and the result says so
+template <typename F>
+FetchResult stream_neighbors(CURL* curl, const std::string& node, F on_neighbor) {
+    NeighborParser<F&> parser(on_neighbor);
+    curl_slist* headers = prepare_neighbors_request(curl, node, &parser);
+
+    FetchResult result;
+    result.curl_code = curl_easy_perform(curl);
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &result.http_code);
+    curl_slist_free_all(headers);
+
+    if (result.ok())
+      parser.finish();
+    if (parser.failed()) {
+      std::cerr<<"Error while parsing JSON response for: "<<node<<" at byte "<<parser.error_position()<<std::endl;
+      throw ParseException(parser.error_code(), parser.error_message(), parser.error_position());
+    }
+    if (!result.ok())
+      std::cerr << "CURL error: " << curl_easy_strerror(result.curl_code) << std::endl;
+
+    result.neighbors = parser.neighbors();
+    return result;
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+// Concurrent string intern table for node names. Each distinct name is stored once and gets a dense
+// uint32_t ID in order of first appearance (0, 1, 2, ...), so the rest of the crawl state (frontiers, queues,
+// visited bitsets) can hold 4-byte IDs instead of std::strings.
+// - name -> ID: lock-striped, so threads interning different names rarely contend. A name's hash picks a
+//   shard, and each shard has its own mutex, arena for the name bytes, and open addressing table of (ID, hash)
+//   slots. A slot is 8 bytes and the name is only compared when the hashes match, so the table costs far
+//   less than a node-based map
+// - ID -> name: a segmented directory of string_views. Segments are allocated on first use and never move,
+//   so name(id) takes no lock. It is safe for any ID the caller got from intern(), or from another thread
+//   through a queue, join or other synchronization
+
+const size_t DEFAULT_INTERN_SHARDS = 256;
+
+// Append-only storage for name bytes. Names never move once added.
+// Blocks start small and double up to MAX_BLOCK_BYTES, so hundreds of lightly used shards stay cheap
+class NameArena {
+    static const size_t MIN_BLOCK_BYTES = 1024;
+    static const size_t MAX_BLOCK_BYTES = 256 * 1024;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    size_t block_used = 0;
+    size_t block_size = 0;
+
+    public:
+
+    std::string_view add(std::string_view s) {
+        if(blocks.empty() || block_used + s.size() > block_size) {
+            //names larger than a block get a block of their own
+            size_t next_size = std::min(MAX_BLOCK_BYTES, std::max(MIN_BLOCK_BYTES, 2 * block_size));
+            block_size = std::max(next_size, s.size());
+            blocks.push_back(std::make_unique<char[]>(block_size));
+            block_used = 0;
+        }
+        char* dst = blocks.back().get() + block_used;
+        std::memcpy(dst, s.data(), s.size());
+        block_used += s.size();
+        return std::string_view(dst, s.size());
+    }
+};
+
+class InternTable {
+    static const uint32_t SEGMENT_BITS = 16;
+    static const uint32_t SEGMENT_SIZE = 1u << SEGMENT_BITS;
+    static const uint32_t MAX_SEGMENTS = 1u << (32 - SEGMENT_BITS);
+
+    static const uint32_t EMPTY_SLOT = UINT32_MAX;
+
+    struct Slot {
+        uint32_t id;
+        uint32_t hash;
+    };
+
+    struct alignas(64) Shard {
+        std::mutex mut;
+        std::vector<Slot> slots;
+        size_t used = 0;
+        NameArena arena;
+    };
+
+    std::unique_ptr<Shard[]> shards;
+    size_t n_shards;
+    std::atomic<uint32_t> next_id{0};
+    std::unique_ptr<std::atomic<std::string_view*>[]> directory;
+    std::mutex directory_mutex;
+
+    //the high half of the hash picks the shard, the low half is the slot hash within it
+    static uint64_t hash_of(std::string_view name) {
+        return uint64_t(std::hash<std::string_view>()(name)) * 0x9e3779b97f4a7c15ULL;
+    }
+
+    Shard& shard_of(uint64_t h) const {
+        return shards[size_t(h >> 32) & (n_shards - 1)];
+    }
+
+    // Linear probing. Returns the slot holding name, or the empty slot where it would go.
+    // Needs the shard lock, and at least one empty slot
+    Slot& probe(Shard& shard, std::string_view name, uint32_t hash) const {
+        size_t mask = shard.slots.size() - 1;
+        for(size_t i = hash & mask; ; i = (i + 1) & mask) {
+            Slot& slot = shard.slots[i];
+            if(slot.id == EMPTY_SLOT) return slot;
+            if(slot.hash == hash && this->name(slot.id) == name) return slot;
+        }
+    }
+
+    //doubles the slot array, keeping the load factor under 3/4. stored hashes mean no name is rehashed
+    void grow(Shard& shard) {
+        std::vector<Slot> old(std::max<size_t>(16, 2 * shard.slots.size()), Slot{EMPTY_SLOT, 0});
+        old.swap(shard.slots);
+        size_t mask = shard.slots.size() - 1;
+        for(const Slot& slot: old) {
+            if(slot.id == EMPTY_SLOT) continue;
+            size_t i = slot.hash & mask;
+            while(shard.slots[i].id != EMPTY_SLOT) i = (i + 1) & mask;
+            shard.slots[i] = slot;
+        }
+    }
+
+    std::string_view* segment(uint32_t s) {
+        std::string_view* seg = directory[s].load(std::memory_order_acquire);
+        if(seg) return seg;
+        std::lock_guard<std::mutex> lg(directory_mutex);
+        seg = directory[s].load(std::memory_order_acquire);
+        if(!seg) {
+            seg = new std::string_view[SEGMENT_SIZE];
+            directory[s].store(seg, std::memory_order_release);
+        }
+        return seg;
+    }
+
+    public:
+
+    // n_shards is rounded up to a power of two
+    InternTable(size_t min_shards = DEFAULT_INTERN_SHARDS) : directory(new std::atomic<std::string_view*>[MAX_SEGMENTS]) {
+        n_shards = 1;
+        while(n_shards < min_shards) n_shards *= 2;
+        shards.reset(new Shard[n_shards]);
+        for(uint32_t s = 0; s < MAX_SEGMENTS; s++) {
+            directory[s].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~InternTable() {
+        for(uint32_t s = 0; s < MAX_SEGMENTS; s++) {
+            delete[] directory[s].load(std::memory_order_relaxed);
+        }
+    }
+
+    InternTable(const InternTable&) = delete;
+    InternTable& operator=(const InternTable&) = delete;
+
+    // Returns name's ID, giving it the next free ID if it is new. If added is not null, it is set to
+    // whether this call added the name
+    uint32_t intern(std::string_view name, bool* added = nullptr) {
+        uint64_t h = hash_of(name);
+        Shard& shard = shard_of(h);
+        std::lock_guard<std::mutex> lg(shard.mut);
+        if(4 * (shard.used + 1) > 3 * shard.slots.size()) grow(shard);
+        Slot& slot = probe(shard, name, uint32_t(h));
+        if(slot.id != EMPTY_SLOT) {
+            if(added) *added = false;
+            return slot.id;
+        }
+
+        uint32_t id = next_id.fetch_add(1, std::memory_order_relaxed);
+        if(id == EMPTY_SLOT) throw std::overflow_error("InternTable is out of IDs");
+        //publish the name before the ID can escape this call
+        segment(id >> SEGMENT_BITS)[id & (SEGMENT_SIZE - 1)] = shard.arena.add(name);
+        slot = Slot{id, uint32_t(h)};
+        shard.used++;
+        if(added) *added = true;
+        return id;
+    }
+
+    // Looks name up without adding it. Returns false if it has no ID
+    bool find(std::string_view name, uint32_t& id) {
+        uint64_t h = hash_of(name);
+        Shard& shard = shard_of(h);
+        std::lock_guard<std::mutex> lg(shard.mut);
+        if(shard.slots.empty()) return false;
+        Slot& slot = probe(shard, name, uint32_t(h));
+        if(slot.id == EMPTY_SLOT) return false;
+        id = slot.id;
+        return true;
+    }
+
+    std::string_view name(uint32_t id) const {
+        return directory[id >> SEGMENT_BITS].load(std::memory_order_acquire)[id & (SEGMENT_SIZE - 1)];
+    }
+
+    // Number of IDs handed out so far. IDs are 0 .. size()-1
+    uint32_t size() const {
+        return next_id.load(std::memory_order_acquire);
+    }
+};
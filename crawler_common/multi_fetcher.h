@@ -0,0 +1,287 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <functional>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <curl/curl.h>
+
+#include "hollywood_client.h"
+
+// Event-driven fetcher for the Hollywood graph service built on curl_multi and epoll.
+// One thread keeps up to max_in_flight requests running at the same time, instead of one blocking
+// curl_easy_perform per OS thread. libcurl tells us which sockets to watch (socket_callback) and when its
+// next timeout is due (timer_callback, backed by a timerfd), and run() feeds epoll events back to
+// curl_multi_socket_action. Finished transfers are handed to their completion callback, which is where the
+// crawlers parse responses and queue more fetches.
+// A failed transfer (curl error, 429 or 5xx) is requested again up to retries times, after a random backoff
+// like RetryPolicy's in reliable_fetch.h. The event loop keeps running other requests meanwhile. Only the
+// last attempt reaches the callback, and nodes whose attempts all fail are counted in the statistics
+class MultiFetcher {
+    public:
+    //called once per finished request with the node name, the curl result, the HTTP status and the body
+    typedef std::function<void(const std::string& node, CURLcode result, long http_code, std::string& body)> Callback;
+
+    private:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr double BACKOFF_BASE = 0.05;    //seconds
+    static constexpr double BACKOFF_CAP = 5;
+
+    struct Request {
+        std::string node;
+        Callback on_done;
+        int attempt = 0;
+    };
+
+    struct Transfer {
+        CURL* easy;
+        Request request;
+        std::string body;
+    };
+
+    CURLM* multi;
+    int epoll_fd;
+    int timer_fd;
+    int max_in_flight;
+    int retries;
+    int in_flight = 0;
+    std::deque<Request> waiting;
+    std::multimap<Clock::time_point, Request> backing_off;     //retries, by when they may start
+    std::mt19937 gen{std::random_device{}()};
+    size_t attempts = 0, retried = 0, failed_nodes = 0;
+    std::vector<CURL*> idle_handles;
+    curl_slist* headers = nullptr;
+
+    static int socket_callback(CURL* easy, curl_socket_t s, int what, void* userp, void* socketp) {
+        MultiFetcher* self = (MultiFetcher*)userp;
+        epoll_event ev = {};
+        ev.data.fd = s;
+        if(what == CURL_POLL_REMOVE) {
+            epoll_ctl(self->epoll_fd, EPOLL_CTL_DEL, s, nullptr);
+            curl_multi_assign(self->multi, s, nullptr);
+            return 0;
+        }
+
+        if(what & CURL_POLL_IN) ev.events |= EPOLLIN;
+        if(what & CURL_POLL_OUT) ev.events |= EPOLLOUT;
+
+        //socketp is null the first time libcurl tells us about a socket
+        if(socketp) {
+            epoll_ctl(self->epoll_fd, EPOLL_CTL_MOD, s, &ev);
+        } else {
+            epoll_ctl(self->epoll_fd, EPOLL_CTL_ADD, s, &ev);
+            curl_multi_assign(self->multi, s, self);
+        }
+        return 0;
+    }
+
+    static int timer_callback(CURLM* multi, long timeout_ms, void* userp) {
+        MultiFetcher* self = (MultiFetcher*)userp;
+        itimerspec its = {};
+        if(timeout_ms > 0) {
+            its.it_value.tv_sec = timeout_ms / 1000;
+            its.it_value.tv_nsec = (timeout_ms % 1000) * 1000000;
+        } else if(timeout_ms == 0) {
+            //"call socket_action right away". an all-zero timerfd would be disarmed, so use 1ns
+            its.it_value.tv_nsec = 1;
+        }
+        //timeout_ms == -1 leaves its zeroed, which disarms the timer
+        timerfd_settime(self->timer_fd, 0, &its, nullptr);
+        return 0;
+    }
+
+    void start_waiting() {
+        while(in_flight < max_in_flight && !waiting.empty()) {
+            Request request = std::move(waiting.front());
+            waiting.pop_front();
+
+            CURL* easy;
+            if(idle_handles.empty()) {
+                easy = curl_easy_init();
+                if(!easy) throw std::runtime_error("Failed to initialize CURL");
+            } else {
+                easy = idle_handles.back();
+                idle_handles.pop_back();
+            }
+
+            Transfer* t = new Transfer{easy, std::move(request), ""};
+            std::string url = SERVICE_URL + url_encode(easy, t->request.node);
+            if(debug)
+                std::cout << "Sending request to: " << url << std::endl;
+
+            curl_easy_setopt(easy, CURLOPT_URL, url.c_str());
+            curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, WriteCallback);
+            curl_easy_setopt(easy, CURLOPT_WRITEDATA, &t->body);
+            curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1L);
+            curl_easy_setopt(easy, CURLOPT_HTTPHEADER, headers);
+            curl_easy_setopt(easy, CURLOPT_PRIVATE, t);
+            curl_multi_add_handle(multi, easy);
+            in_flight++;
+            attempts++;
+        }
+    }
+
+    // Queues the retries whose backoff is over
+    void release_backed_off() {
+        Clock::time_point now = Clock::now();
+        while(!backing_off.empty() && backing_off.begin()->first <= now) {
+            waiting.push_back(std::move(backing_off.begin()->second));
+            backing_off.erase(backing_off.begin());
+        }
+    }
+
+    // How long epoll may wait: at most a second, and not past the end of the first backoff
+    int wait_ms() const {
+        if(backing_off.empty()) return 1000;
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(backing_off.begin()->first - Clock::now()).count();
+        return int(std::max<long long>(0, std::min<long long>(1000, left + 1)));
+    }
+
+    void check_completed() {
+        CURLMsg* msg;
+        int msgs_left;
+        while((msg = curl_multi_info_read(multi, &msgs_left))) {
+            if(msg->msg != CURLMSG_DONE) continue;
+
+            CURL* easy = msg->easy_handle;
+            CURLcode result = msg->data.result;
+            Transfer* t;
+            long http_code = 0;
+            curl_easy_getinfo(easy, CURLINFO_PRIVATE, (char**)&t);
+            curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &http_code);
+            curl_multi_remove_handle(multi, easy);
+            idle_handles.push_back(easy);
+            in_flight--;
+
+            if(result != CURLE_OK)
+                std::cerr << "CURL error: " << curl_easy_strerror(result) << std::endl;
+            if(debug)
+                std::cout << "Response received: " << t->body << std::endl;
+
+            Request& request = t->request;
+            if(failed(result, http_code)) {
+                if(request.attempt < retries) {
+                    //full jitter: a random wait up to BACKOFF_BASE * 2^attempt
+                    request.attempt++;
+                    retried++;
+                    double cap = std::min(BACKOFF_CAP, BACKOFF_BASE * double(1 << std::min(request.attempt, 20)));
+                    auto delay = std::chrono::duration<double>(std::uniform_real_distribution<double>(0, cap)(gen));
+                    backing_off.emplace(Clock::now() + std::chrono::duration_cast<Clock::duration>(delay), std::move(request));
+                    delete t;
+                    continue;
+                }
+                failed_nodes++;
+                std::cerr << "Giving up on " << request.node << " after " << request.attempt + 1 << " attempts" << std::endl;
+            }
+
+            //the callback may queue more requests, they are started on the next loop iteration
+            request.on_done(request.node, result, http_code, t->body);
+            delete t;
+        }
+    }
+
+    public:
+
+    MultiFetcher(int max_in_flight, int retries = 3) : max_in_flight(max_in_flight), retries(retries) {
+        //with no request allowed in flight, run() would wait forever for transfers it never starts
+        if(max_in_flight < 1) {
+            throw std::invalid_argument("max_in_flight must be positive");
+        }
+        if(retries < 0) {
+            throw std::invalid_argument("retries must not be negative");
+        }
+        multi = curl_multi_init();
+        epoll_fd = epoll_create1(0);
+        //non-blocking: a socket_action earlier in the same batch of events can re-arm the timer, which clears the
+        //expiry epoll reported, and a blocking read would then wait for the next one
+        timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+        if(!multi || epoll_fd < 0 || timer_fd < 0) {
+            throw std::runtime_error("Failed to initialize the curl_multi event loop");
+        }
+
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = timer_fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev);
+
+        curl_multi_setopt(multi, CURLMOPT_SOCKETFUNCTION, socket_callback);
+        curl_multi_setopt(multi, CURLMOPT_SOCKETDATA, this);
+        curl_multi_setopt(multi, CURLMOPT_TIMERFUNCTION, timer_callback);
+        curl_multi_setopt(multi, CURLMOPT_TIMERDATA, this);
+        //keep one cached connection per request slot so connections get reused across requests
+        curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, long(max_in_flight));
+
+        // Set a User-Agent header to avoid potential blocking by the server
+        headers = curl_slist_append(headers, "User-Agent: C++-Client/1.0");
+    }
+
+    ~MultiFetcher() {
+        for(CURL* easy: idle_handles) {
+            curl_easy_cleanup(easy);
+        }
+        curl_multi_cleanup(multi);
+        curl_slist_free_all(headers);
+        close(timer_fd);
+        close(epoll_fd);
+    }
+
+    MultiFetcher(const MultiFetcher&) = delete;
+    MultiFetcher& operator=(const MultiFetcher&) = delete;
+
+    // Whether a transfer failed in a way worth retrying. The callbacks should treat such a response as empty
+    static bool failed(CURLcode result, long http_code) {
+        return result != CURLE_OK || http_code == 429 || http_code >= 500;
+    }
+
+    // Queues a request for node's neighbors. on_done runs on the thread calling run()
+    void fetch(const std::string& node, Callback on_done) {
+        waiting.push_back({node, std::move(on_done)});
+    }
+
+    // Runs the event loop until every queued request, including ones queued by callbacks, has finished
+    void run() {
+        const int MAX_EVENTS = 64;
+        epoll_event events[MAX_EVENTS];
+        int running = 0;
+
+        start_waiting();
+        while(in_flight > 0 || !waiting.empty() || !backing_off.empty()) {
+            int n = epoll_wait(epoll_fd, events, MAX_EVENTS, wait_ms());
+            for(int i = 0; i < n; i++) {
+                if(events[i].data.fd == timer_fd) {
+                    uint64_t expirations;
+                    ssize_t unused = read(timer_fd, &expirations, sizeof(expirations));
+                    (void)unused;
+                    curl_multi_socket_action(multi, CURL_SOCKET_TIMEOUT, 0, &running);
+                    continue;
+                }
+
+                int flags = 0;
+                if(events[i].events & EPOLLIN) flags |= CURL_CSELECT_IN;
+                if(events[i].events & EPOLLOUT) flags |= CURL_CSELECT_OUT;
+                if(events[i].events & (EPOLLERR | EPOLLHUP)) flags |= CURL_CSELECT_ERR;
+                curl_multi_socket_action(multi, events[i].data.fd, flags, &running);
+            }
+            check_completed();
+            release_backed_off();
+            start_waiting();
+        }
+    }
+
+    int requests_in_flight() const {
+        return in_flight;
+    }
+
+    void print_stats(std::ostream& out) const {
+        out << "Fetch attempts: " << attempts << ", " << retried << " retries, " << failed_nodes << " nodes failed\n";
+    }
+};
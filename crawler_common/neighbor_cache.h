@@ -0,0 +1,280 @@
+#pragma once
+
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+
+#include "hollywood_client.h"
+#include "concurrency_limiter.h"
+#include "reliable_fetch.h"
+
+// Persistent cache of neighbor lists, shared by crawler runs and by crawler processes running at the same time.
+// The cache is one file: a header page, then an append-only log of records, each a node name, the time it was
+// fetched and its parsed neighbor names. The file is mapped once with a large fixed reservation, so records
+// never move and lookups hand out string_views straight into the mapping.
+// - Writers append under an flock (and a mutex for this process's threads): grow the file if needed, copy the
+//   record in, then publish it by storing the new end of the log in the header with release ordering. A
+//   writer that dies halfway never publishes its record and the next writer overwrites it
+// - Readers load the end of the log with acquire ordering, so everything before it is complete. Each process
+//   keeps a hash index from name to its newest record, and catches up on records other processes appended
+//   whenever the end of the log has moved
+// Entries older than the TTL are refetched and appended again; the newer record wins in the index.
+// Records are keyed by node name only, so the header records the service the cache was filled from, and a
+// cache is refused when the crawl runs against another one (HOLLYWOOD_GRAPH_URL, see hollywood_client.h).
+// --cache-only never contacts the service and serves entries of any age
+
+struct CacheOptions {
+    std::string path;           //empty: no cache
+    long long ttl_seconds = -1; //-1: entries never expire
+    bool cache_only = false;
+};
+
+inline const char* CACHE_OPTIONS_USAGE =
+    "  --cache FILE        keep fetched neighbor lists in FILE and reuse them in later runs\n"
+    "  --cache-ttl SEC     refetch cached entries older than SEC seconds (default: never)\n"
+    "  --cache-only        never contact the service, nodes missing from the cache have no neighbors\n";
+
+// Parses the cache option at argv[i], moving i past its value. Returns false if argv[i] is not a cache option
+inline bool parse_cache_option(int argc, char* argv[], int& i, CacheOptions& opts) {
+    std::string flag = argv[i];
+    if (flag == "--cache-only") {
+        opts.cache_only = true;
+        return true;
+    }
+    if (flag != "--cache" && flag != "--cache-ttl") return false;
+    if (i + 1 >= argc) throw std::invalid_argument(flag + " needs a value");
+    std::string value = argv[++i];
+    if (flag == "--cache") {
+        opts.path = value;
+        return true;
+    }
+    opts.ttl_seconds = std::stoll(value);
+    if (opts.ttl_seconds < 0) throw std::invalid_argument("--cache-ttl must not be negative");
+    return true;
+}
+
+class NeighborCache {
+    static const uint64_t MAGIC = 0x3245484341434e48ULL;   //"HNCACHE2"
+    static const uint64_t HEADER_BYTES = 4096;
+    static const uint64_t MIN_GROWTH = 1 << 20;
+    //address space reserved for the mapping. the file only takes what the log uses
+    static const uint64_t MAP_BYTES = uint64_t(1) << 36;
+
+    struct Header {
+        uint64_t magic;
+        uint64_t committed;     //end of the published log, only accessed atomically
+        uint64_t service_bytes;
+        char service[HEADER_BYTES - 3 * sizeof(uint64_t)];  //SERVICE_URL of the crawl that created the file
+    };
+
+    struct Record {
+        uint32_t bytes;         //whole record, padded to 8
+        uint32_t name_bytes;
+        uint32_t neighbors;
+        uint32_t reserved;
+        int64_t fetched_at;
+        //then the name, then neighbors as (uint32_t length, bytes)
+    };
+
+    CacheOptions opts;
+    int fd = -1;
+    bool writable;
+    char* base = nullptr;
+
+    std::shared_mutex index_mutex;
+    std::unordered_map<std::string_view, uint64_t> index;
+    std::atomic<uint64_t> scanned{HEADER_BYTES};
+    std::mutex write_mutex;
+
+    std::atomic<uint64_t> hits{0}, misses{0}, stale{0}, stores{0};
+
+    Header* header() const {
+        return (Header*)base;
+    }
+
+    uint64_t committed() const {
+        return __atomic_load_n(&header()->committed, __ATOMIC_ACQUIRE);
+    }
+
+    std::string_view record_name(uint64_t offset) const {
+        const Record* r = (const Record*)(base + offset);
+        return std::string_view(base + offset + sizeof(Record), r->name_bytes);
+    }
+
+    // Indexes records published since the last call, ours or other processes'
+    void catch_up() {
+        uint64_t end = committed();
+        if (scanned.load(std::memory_order_acquire) >= end) return;
+        std::unique_lock<std::shared_mutex> lg(index_mutex);
+        uint64_t offset = scanned.load(std::memory_order_relaxed);
+        while (offset < end) {
+            index[record_name(offset)] = offset;
+            offset += ((const Record*)(base + offset))->bytes;
+        }
+        scanned.store(offset, std::memory_order_release);
+    }
+
+    void fail(const std::string& what) {
+        if (fd >= 0) close(fd);
+        throw std::runtime_error("Neighbor cache " + opts.path + ": " + what);
+    }
+
+    public:
+
+    NeighborCache(const CacheOptions& options) : opts(options) {
+        //offline runs never fetch anything to store, so they only need read access
+        writable = !opts.cache_only;
+        fd = writable ? open(opts.path.c_str(), O_RDWR | O_CREAT, 0644) : open(opts.path.c_str(), O_RDONLY);
+        if (fd < 0) fail("cannot open");
+
+        //the first process to get here writes the header
+        if (writable) {
+            flock(fd, LOCK_EX);
+            struct stat st;
+            fstat(fd, &st);
+            if (st.st_size == 0) {
+                Header h = {MAGIC, HEADER_BYTES, SERVICE_URL.size()};
+                if (SERVICE_URL.size() > sizeof(h.service)) {
+                    flock(fd, LOCK_UN);
+                    fail("service URL too long");
+                }
+                std::memcpy(h.service, SERVICE_URL.data(), SERVICE_URL.size());
+                if (ftruncate(fd, HEADER_BYTES + MIN_GROWTH) != 0 || pwrite(fd, &h, sizeof(h), 0) != sizeof(h)) {
+                    flock(fd, LOCK_UN);
+                    fail("cannot initialize");
+                }
+            }
+            flock(fd, LOCK_UN);
+        }
+
+        void* m = mmap(nullptr, MAP_BYTES, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+        if (m == MAP_FAILED) fail("cannot map");
+        base = (char*)m;
+        struct stat st;
+        fstat(fd, &st);
+        if (uint64_t(st.st_size) < HEADER_BYTES || header()->magic != MAGIC) {
+            munmap(base, MAP_BYTES);
+            fail("not a neighbor cache");
+        }
+        std::string_view service(header()->service, std::min<uint64_t>(header()->service_bytes, sizeof(header()->service)));
+        if (service != SERVICE_URL) {
+            std::string filled_from(service);
+            munmap(base, MAP_BYTES);
+            fail("filled from " + filled_from + ", not " + SERVICE_URL);
+        }
+        catch_up();
+    }
+
+    ~NeighborCache() {
+        munmap(base, MAP_BYTES);
+        close(fd);
+    }
+
+    NeighborCache(const NeighborCache&) = delete;
+    NeighborCache& operator=(const NeighborCache&) = delete;
+
+    bool cache_only() const {
+        return opts.cache_only;
+    }
+
+    // Calls f(std::string_view) for each cached neighbor of node. Returns false, without calling f, if node
+    // has no entry or, unless the cache is cache-only, its entry is older than the TTL
+    template <typename F>
+    bool lookup(std::string_view node, F f) {
+        catch_up();
+        uint64_t offset;
+        {
+            std::shared_lock<std::shared_mutex> lg(index_mutex);
+            auto it = index.find(node);
+            if (it == index.end()) {
+                misses++;
+                return false;
+            }
+            offset = it->second;
+        }
+
+        const Record* r = (const Record*)(base + offset);
+        if (!opts.cache_only && opts.ttl_seconds >= 0 && std::time(nullptr) - r->fetched_at > opts.ttl_seconds) {
+            stale++;
+            return false;
+        }
+        hits++;
+        //records are never modified once published, so no lock is needed to read one
+        const char* p = base + offset + sizeof(Record) + r->name_bytes;
+        for (uint32_t i = 0; i < r->neighbors; i++) {
+            uint32_t len;
+            std::memcpy(&len, p, sizeof(len));
+            f(std::string_view(p + sizeof(len), len));
+            p += sizeof(len) + len;
+        }
+        return true;
+    }
+
+    // Appends node's neighbors, packed as (uint32_t length, bytes) per name
+    void store(std::string_view node, uint32_t neighbors, const std::string& packed) {
+        if (!writable) return;
+        uint64_t bytes = (sizeof(Record) + node.size() + packed.size() + 7) & ~uint64_t(7);
+        Record r = {uint32_t(bytes), uint32_t(node.size()), neighbors, 0, int64_t(std::time(nullptr))};
+
+        std::lock_guard<std::mutex> lg(write_mutex);
+        flock(fd, LOCK_EX);
+        uint64_t end = committed();
+        struct stat st;
+        fstat(fd, &st);
+        if (end + bytes > MAP_BYTES) {
+            flock(fd, LOCK_UN);
+            return;
+        }
+        if (end + bytes > uint64_t(st.st_size)) {
+            uint64_t size = std::min(MAP_BYTES, std::max(end + bytes, uint64_t(st.st_size) + std::max(MIN_GROWTH, uint64_t(st.st_size) / 4)));
+            if (ftruncate(fd, size) != 0) {
+                flock(fd, LOCK_UN);
+                return;
+            }
+        }
+        char* dst = base + end;
+        std::memcpy(dst, &r, sizeof(r));
+        std::memcpy(dst + sizeof(r), node.data(), node.size());
+        std::memcpy(dst + sizeof(r) + node.size(), packed.data(), packed.size());
+        __atomic_store_n(&header()->committed, end + bytes, __ATOMIC_RELEASE);
+        flock(fd, LOCK_UN);
+        stores++;
+    }
+
+    void print_stats(std::ostream& out) const {
+        out << "Cache: " << hits << " hits, " << misses << " misses, " << stale << " stale, " << stores << " stored\n";
+    }
+};
+
+// Neighbors of node from the cache when it has a usable entry, otherwise fetched from the service as retry
+// says and then cached. A fetch is only cached once a whole response is in, so failed or cut off transfers are
+// refetched next time. Requests to the service wait for a permit from limiter, if there is one; cache hits do
+// not. Without a cache this is just retry.fetch
+template <typename F>
+void cached_neighbors(CURL* curl, NeighborCache* cache, ConcurrencyLimiter* limiter, RetryPolicy& retry, const std::string& node, F on_neighbor) {
+    if (!cache) {
+        retry.fetch(curl, limiter, node, on_neighbor, nullptr);
+        return;
+    }
+    if (cache->lookup(node, on_neighbor) || cache->cache_only())
+        return;
+
+    //one buffer per thread, reused for every record it writes
+    thread_local std::string packed;
+    FetchResult result = retry.fetch(curl, limiter, node, on_neighbor, &packed);
+    if (result.ok() && result.http_code == 200)
+        cache->store(node, result.neighbors, packed);
+}
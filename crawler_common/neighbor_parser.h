@@ -0,0 +1,402 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "rapidjson/error/error.h"
+
+// Incremental JSON parser for the graph service's responses, {"node": ..., "neighbors": ["a", "b", ...]}.
+// rapidjson's readers pull from a stream, which the curl write callback cannot offer, so this is a small push
+// parser instead: feed() takes the body in whatever chunks curl delivers and can stop at any byte, in the
+// middle of a string or an escape. It checks the whole document like a validating tokenizer, but only keeps
+// the strings of the top-level "neighbors" array, handing each to on_neighbor as a string_view as soon as its
+// closing quote arrives. There is no body buffer and no DOM. A name that fits in one chunk and has no escapes
+// points straight into curl's buffer; only names split across chunks or with escapes go through a scratch
+// string that is reused for the whole response. Views are valid until on_neighbor returns.
+// Errors use rapidjson's codes and byte offsets. After an error feed() returns false and ignores further input
+
+template <typename Sink>
+class NeighborParser {
+    enum State {
+        VALUE,          //expecting a value
+        FIRST_VALUE,    //after '[', a value or ']'
+        FIRST_KEY,      //after '{', a key or '}'
+        KEY,            //after ',' in an object
+        COLON,
+        AFTER_VALUE,    //',' or the closing bracket, or the end of the document
+        STRING,
+        ESCAPE,         //after a backslash
+        UNICODE,        //inside \uXXXX
+        NUMBER,
+        LITERAL,        //true, false or null
+        DONE
+    };
+
+    //where a number is: -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+    enum NumberPart {
+        SIGN,           //after '-', a digit must follow
+        ZERO,           //a leading 0, no more integer digits
+        INT,
+        POINT,          //after '.', a digit must follow
+        FRACTION,
+        EXP,            //after 'e' or 'E', a sign or digit must follow
+        EXP_SIGN,       //after the exponent's sign, a digit must follow
+        EXP_DIGITS
+    };
+
+    Sink on_neighbor;
+    State state = VALUE;
+    std::vector<char> nesting;  //'{' or '[' per open container
+
+    //string state: whether the string is kept, and whether it is a key
+    bool capture = false;
+    bool is_key = false;
+    bool in_scratch = false;
+    std::string scratch;
+    uint32_t code_unit = 0;
+    int hex_digits = 0;
+    uint32_t high_surrogate = 0;
+
+    //whether the top-level object's last key was "neighbors", and whether we are inside that array
+    bool neighbors_key = false;
+    bool in_neighbors = false;
+    size_t neighbors_found = 0;
+
+    NumberPart number_part = SIGN;
+    const char* literal = nullptr;
+    bool seen_value = false;
+    size_t offset = 0;
+
+    rapidjson::ParseErrorCode error = rapidjson::kParseErrorNone;
+    const char* error_name = nullptr;
+    size_t error_offset = 0;
+
+#define NEIGHBOR_PARSE_FAIL(code, at) \
+    do { error = rapidjson::code; error_name = #code; error_offset = (at); return false; } while(0)
+
+    static bool is_space(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    void append_utf8(uint32_t cp) {
+        if (cp < 0x80) {
+            scratch.push_back(char(cp));
+        } else if (cp < 0x800) {
+            scratch.push_back(char(0xC0 | (cp >> 6)));
+            scratch.push_back(char(0x80 | (cp & 0x3F)));
+        } else if (cp < 0x10000) {
+            scratch.push_back(char(0xE0 | (cp >> 12)));
+            scratch.push_back(char(0x80 | ((cp >> 6) & 0x3F)));
+            scratch.push_back(char(0x80 | (cp & 0x3F)));
+        } else {
+            scratch.push_back(char(0xF0 | (cp >> 18)));
+            scratch.push_back(char(0x80 | ((cp >> 12) & 0x3F)));
+            scratch.push_back(char(0x80 | ((cp >> 6) & 0x3F)));
+            scratch.push_back(char(0x80 | (cp & 0x3F)));
+        }
+    }
+
+    void end_value() {
+        state = nesting.empty() ? DONE : AFTER_VALUE;
+    }
+
+    // Checks that the number ends in a digit, where it stops at offset at
+    bool number_complete(size_t at) {
+        switch (number_part) {
+        case SIGN: NEIGHBOR_PARSE_FAIL(kParseErrorValueInvalid, at);
+        case POINT: NEIGHBOR_PARSE_FAIL(kParseErrorNumberMissFraction, at);
+        case EXP:
+        case EXP_SIGN: NEIGHBOR_PARSE_FAIL(kParseErrorNumberMissExponent, at);
+        default: return true;
+        }
+    }
+
+    void begin_string(bool key) {
+        is_key = key;
+        //keys are only interesting in the top-level object, values only in its neighbors array
+        capture = key ? nesting.size() == 1 : in_neighbors && nesting.size() == 2;
+        in_scratch = false;
+        scratch.clear();
+        state = STRING;
+    }
+
+    void end_string(std::string_view s) {
+        if (is_key) {
+            if (nesting.size() == 1) neighbors_key = s == "neighbors";
+            state = COLON;
+            return;
+        }
+        if (capture) {
+            neighbors_found++;
+            on_neighbor(s);
+        }
+        end_value();
+    }
+
+    void begin_container(char bracket) {
+        //the neighbors array is the value of the top-level key "neighbors"
+        if (nesting.size() == 1) in_neighbors = bracket == '[' && neighbors_key;
+        nesting.push_back(bracket);
+        state = bracket == '{' ? FIRST_KEY : FIRST_VALUE;
+    }
+
+    void end_container() {
+        nesting.pop_back();
+        if (nesting.size() == 1) in_neighbors = false;
+        end_value();
+    }
+
+    // Scans a string from p, stopping at the closing quote, a backslash or the end of the chunk
+    bool string_chars(const char*& p, const char* end, size_t base) {
+        const char* start = p;
+        //after the first half of a surrogate pair, only the escape for the second half may follow
+        if (high_surrogate && p < end && *p != '\\') NEIGHBOR_PARSE_FAIL(kParseErrorStringEscapeInvalid, base);
+        while (p < end && *p != '"' && *p != '\\') {
+            if ((unsigned char)*p < 0x20) NEIGHBOR_PARSE_FAIL(kParseErrorStringMissQuotationMark, base + (p - start));
+            p++;
+        }
+        if (!capture) {
+            if (p < end && *p == '"') {
+                p++;
+                end_string(std::string_view());
+            }
+            return true;
+        }
+        if (p < end && *p == '"' && !in_scratch) {
+            //the whole string is in this chunk, no copy
+            std::string_view s(start, p - start);
+            p++;
+            end_string(s);
+            return true;
+        }
+        scratch.append(start, p - start);
+        in_scratch = true;
+        if (p < end && *p == '"') {
+            p++;
+            end_string(scratch);
+        }
+        return true;
+    }
+
+    public:
+
+    NeighborParser(Sink on_neighbor) : on_neighbor(on_neighbor) {
+    }
+
+    // Parses the next chunk of the response. Returns false on a syntax error
+    bool feed(const char* data, size_t n) {
+        if (error != rapidjson::kParseErrorNone) return false;
+        const char* p = data;
+        const char* end = data + n;
+        while (p < end) {
+            size_t at = offset + (p - data);
+            char c = *p;
+            switch (state) {
+            case STRING:
+                if (!string_chars(p, end, at)) return false;
+                if (state == STRING && p < end) {
+                    //stopped at a backslash
+                    p++;
+                    state = ESCAPE;
+                }
+                continue;
+
+            case ESCAPE: {
+                char decoded;
+                switch (c) {
+                case '"': decoded = '"'; break;
+                case '\\': decoded = '\\'; break;
+                case '/': decoded = '/'; break;
+                case 'b': decoded = '\b'; break;
+                case 'f': decoded = '\f'; break;
+                case 'n': decoded = '\n'; break;
+                case 'r': decoded = '\r'; break;
+                case 't': decoded = '\t'; break;
+                case 'u':
+                    code_unit = 0;
+                    hex_digits = 0;
+                    state = UNICODE;
+                    p++;
+                    continue;
+                default:
+                    NEIGHBOR_PARSE_FAIL(kParseErrorStringEscapeInvalid, at);
+                }
+                if (high_surrogate) NEIGHBOR_PARSE_FAIL(kParseErrorStringEscapeInvalid, at);
+                in_scratch = true;
+                if (capture) scratch.push_back(decoded);
+                state = STRING;
+                p++;
+                continue;
+            }
+
+            case UNICODE: {
+                int v;
+                if (c >= '0' && c <= '9') v = c - '0';
+                else if (c >= 'a' && c <= 'f') v = c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F') v = c - 'A' + 10;
+                else NEIGHBOR_PARSE_FAIL(kParseErrorStringEscapeInvalid, at);
+                code_unit = code_unit * 16 + v;
+                p++;
+                if (++hex_digits < 4) continue;
+
+                in_scratch = true;
+                state = STRING;
+                if (code_unit >= 0xD800 && code_unit <= 0xDBFF) {
+                    //first half of a surrogate pair, the second must be the next escape
+                    if (high_surrogate) NEIGHBOR_PARSE_FAIL(kParseErrorStringEscapeInvalid, at);
+                    high_surrogate = code_unit;
+                    continue;
+                }
+                uint32_t cp = code_unit;
+                if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    if (!high_surrogate) NEIGHBOR_PARSE_FAIL(kParseErrorStringEscapeInvalid, at);
+                    cp = 0x10000 + ((high_surrogate - 0xD800) << 10) + (cp - 0xDC00);
+                } else if (high_surrogate) {
+                    NEIGHBOR_PARSE_FAIL(kParseErrorStringEscapeInvalid, at);
+                }
+                high_surrogate = 0;
+                if (capture) append_utf8(cp);
+                continue;
+            }
+
+            case NUMBER: {
+                //numbers are checked but not kept
+                bool digit = c >= '0' && c <= '9';
+                NumberPart next = number_part;
+                if (digit && number_part != ZERO) {
+                    if (number_part == SIGN) next = c == '0' ? ZERO : INT;
+                    else if (number_part == POINT) next = FRACTION;
+                    else if (number_part == EXP || number_part == EXP_SIGN) next = EXP_DIGITS;
+                } else if (c == '.' && (number_part == ZERO || number_part == INT)) {
+                    next = POINT;
+                } else if ((c == 'e' || c == 'E') && (number_part == ZERO || number_part == INT || number_part == FRACTION)) {
+                    next = EXP;
+                } else if ((c == '+' || c == '-') && number_part == EXP) {
+                    next = EXP_SIGN;
+                } else {
+                    //the number ends before c, which the next state reads
+                    if (!number_complete(at)) return false;
+                    end_value();
+                    continue;
+                }
+                number_part = next;
+                p++;
+                continue;
+            }
+
+            case LITERAL:
+                if (*literal == '\0') {
+                    end_value();
+                    continue;
+                }
+                if (c != *literal) NEIGHBOR_PARSE_FAIL(kParseErrorValueInvalid, at);
+                literal++;
+                p++;
+                continue;
+
+            default:
+                break;
+            }
+
+            if (is_space(c)) {
+                p++;
+                continue;
+            }
+
+            switch (state) {
+            case FIRST_VALUE:
+                if (c == ']') {
+                    end_container();
+                    break;
+                }
+                state = VALUE;
+                continue;
+
+            case VALUE:
+                seen_value = true;
+                if (c == '"') begin_string(false);
+                else if (c == '{' || c == '[') begin_container(c);
+                else if (c == '-' || (c >= '0' && c <= '9')) {
+                    number_part = c == '-' ? SIGN : c == '0' ? ZERO : INT;
+                    state = NUMBER;
+                }
+                else if (c == 't') { literal = "rue"; state = LITERAL; }
+                else if (c == 'f') { literal = "alse"; state = LITERAL; }
+                else if (c == 'n') { literal = "ull"; state = LITERAL; }
+                else NEIGHBOR_PARSE_FAIL(kParseErrorValueInvalid, at);
+                break;
+
+            case FIRST_KEY:
+            case KEY:
+                if (c == '"') begin_string(true);
+                else if (c == '}' && state == FIRST_KEY) end_container();
+                else NEIGHBOR_PARSE_FAIL(kParseErrorObjectMissName, at);
+                break;
+
+            case COLON:
+                if (c != ':') NEIGHBOR_PARSE_FAIL(kParseErrorObjectMissColon, at);
+                state = VALUE;
+                break;
+
+            case AFTER_VALUE:
+                if (nesting.back() == '{') {
+                    if (c == ',') state = KEY;
+                    else if (c == '}') end_container();
+                    else NEIGHBOR_PARSE_FAIL(kParseErrorObjectMissCommaOrCurlyBracket, at);
+                } else {
+                    if (c == ',') state = VALUE;
+                    else if (c == ']') end_container();
+                    else NEIGHBOR_PARSE_FAIL(kParseErrorArrayMissCommaOrSquareBracket, at);
+                }
+                break;
+
+            case DONE:
+                NEIGHBOR_PARSE_FAIL(kParseErrorDocumentRootNotSingular, at);
+
+            default:
+                break;
+            }
+            p++;
+        }
+        offset += n;
+        return true;
+    }
+
+    // Ends the response. Returns false if it was empty or stopped in the middle of a value
+    bool finish() {
+        if (error != rapidjson::kParseErrorNone) return false;
+        if (state == NUMBER && !number_complete(offset)) return false;
+        if (state == NUMBER && nesting.empty()) state = DONE;
+        if (state == LITERAL && *literal == '\0' && nesting.empty()) state = DONE;
+        if (state == DONE) return true;
+        if (!seen_value) NEIGHBOR_PARSE_FAIL(kParseErrorDocumentEmpty, offset);
+        if (state == STRING || state == ESCAPE || state == UNICODE) NEIGHBOR_PARSE_FAIL(kParseErrorStringMissQuotationMark, offset);
+        if (!nesting.empty() && nesting.back() == '{') NEIGHBOR_PARSE_FAIL(kParseErrorObjectMissCommaOrCurlyBracket, offset);
+        if (!nesting.empty()) NEIGHBOR_PARSE_FAIL(kParseErrorArrayMissCommaOrSquareBracket, offset);
+        NEIGHBOR_PARSE_FAIL(kParseErrorValueInvalid, offset);
+    }
+
+#undef NEIGHBOR_PARSE_FAIL
+
+    bool failed() const {
+        return error != rapidjson::kParseErrorNone;
+    }
+
+    rapidjson::ParseErrorCode error_code() const {
+        return error;
+    }
+
+    const char* error_message() const {
+        return error_name;
+    }
+
+    size_t error_position() const {
+        return error_offset;
+    }
+
+    size_t neighbors() const {
+        return neighbors_found;
+    }
+};
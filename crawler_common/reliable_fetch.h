@@ -0,0 +1,359 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <exception>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <random>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <curl/curl.h>
+
+#include "hollywood_client.h"
+#include "concurrency_limiter.h"
+
+// Timeouts, retries and hedged requests for neighbor fetches, so that one slow or failed request neither holds
+// up a whole BFS level nor silently drops a node's subgraph.
+// - every attempt gives up after --timeout milliseconds
+// - a failed attempt (curl error or timeout, 429 or 5xx, or a malformed body) is retried up to --retries times.
+//   Before retry n the thread sleeps a random time between 0 and BACKOFF_BASE * 2^n ("full jitter"), so threads
+//   that failed together, e.g. on a server hiccup, do not all come back at the same moment
+// - with --hedge, an attempt still running after the 95th percentile of recent request latencies gets a
+//   duplicate on a second connection, and the first complete response wins while the other is aborted. The
+//   duplicate only costs a request for the slowest 5% or so
+// Hedged attempts keep each response's neighbors in a buffer and only pass on the winner's. Without hedging
+// they stream as before, and if an attempt fails part way, its retry passes on names that were already passed
+// on, which the crawlers' visited sets absorb.
+// A node whose attempts all fail ends up without neighbors, as before, but is counted in the statistics
+
+struct RetryOptions {
+    int retries = 3;
+    long timeout_ms = 30000;
+    bool hedge = false;
+};
+
+inline const char* RETRY_OPTIONS_USAGE =
+    "  --retries N         retry a failed request up to N times (default 3)\n"
+    "  --timeout MS        give up on a request after MS milliseconds (default 30000)\n"
+    "  --hedge             duplicate requests still running after the 95th percentile latency, the first\n"
+    "                      response wins\n";
+
+// Parses the retry option at argv[i], moving i past its value. Returns false if argv[i] is not a retry option
+inline bool parse_retry_option(int argc, char* argv[], int& i, RetryOptions& opts) {
+    std::string flag = argv[i];
+    if (flag == "--hedge") {
+        opts.hedge = true;
+        return true;
+    }
+    if (flag != "--retries" && flag != "--timeout") return false;
+    if (i + 1 >= argc) throw std::invalid_argument(flag + " needs a value");
+    std::string value = argv[++i];
+    if (flag == "--retries") opts.retries = std::stoi(value);
+    else opts.timeout_ms = std::stol(value);
+    if (opts.retries < 0 || opts.timeout_ms <= 0) throw std::invalid_argument(flag + " must be positive");
+    return true;
+}
+
+// Latencies of the most recent successful requests, for the hedge delay
+class LatencyWindow {
+    static const size_t SIZE = 512;
+    static const size_t MIN_SAMPLES = 20;   //no percentile before this many
+    static const size_t RECOMPUTE = 16;     //samples between updates of the percentile
+
+    std::mutex mut;
+    std::vector<double> samples;
+    size_t next = 0;
+    uint64_t added = 0;
+    std::vector<double> scratch;
+    std::atomic<double> p95{-1};
+
+    public:
+
+    void add(double seconds) {
+        std::lock_guard<std::mutex> lg(mut);
+        if (samples.size() < SIZE) samples.push_back(seconds);
+        else samples[next] = seconds;
+        next = (next + 1) % SIZE;
+        added++;
+        if (samples.size() < MIN_SAMPLES || (added - MIN_SAMPLES) % RECOMPUTE != 0) return;
+
+        scratch = samples;
+        size_t k = scratch.size() * 95 / 100;
+        std::nth_element(scratch.begin(), scratch.begin() + k, scratch.end());
+        p95.store(scratch[k], std::memory_order_relaxed);
+    }
+
+    // In seconds, -1 until there are enough samples
+    double percentile95() const {
+        return p95.load(std::memory_order_relaxed);
+    }
+};
+
+// Calls f(std::string_view) for each name in a buffer of (uint32_t length, bytes) entries
+template <typename F>
+void for_each_packed(const std::string& packed, F f) {
+    const char* p = packed.data();
+    const char* end = p + packed.size();
+    while (p < end) {
+        uint32_t len;
+        std::memcpy(&len, p, sizeof(len));
+        f(std::string_view(p + sizeof(len), len));
+        p += sizeof(len) + len;
+    }
+}
+
+// Appends each name it is given to a buffer of (uint32_t length, bytes) entries
+struct PackNeighbors {
+    std::string* out;
+
+    void operator()(std::string_view neighbor) {
+        uint32_t len = neighbor.size();
+        out->append((const char*)&len, sizeof(len));
+        out->append(neighbor.data(), neighbor.size());
+    }
+};
+
+// Shared by all crawler threads
+class RetryPolicy {
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr double BACKOFF_BASE = 0.05;    //seconds
+    static constexpr double BACKOFF_CAP = 5;
+
+    // How one attempt went
+    struct Outcome {
+        FetchResult result;
+        std::exception_ptr parse_error;
+
+        bool ok() const {
+            return result.ok() && !result.server_error() && !parse_error;
+        }
+    };
+
+    // One of the two transfers of a hedged attempt
+    struct Transfer {
+        CURL* curl;
+        std::string packed;
+        NeighborParser<PackNeighbors> parser;
+        curl_slist* headers = nullptr;
+        Clock::time_point started;
+        bool used = false;
+        bool running = false;
+
+        Transfer(CURL* curl) : curl(curl), parser(PackNeighbors{&packed}) {}
+    };
+
+    // The multi handle and the second connection for hedging, one per crawler thread
+    struct HedgeHandles {
+        CURLM* multi = nullptr;
+        CURL* spare = nullptr;
+
+        ~HedgeHandles() {
+            if (spare) curl_easy_cleanup(spare);
+            if (multi) curl_multi_cleanup(multi);
+        }
+    };
+
+    RetryOptions opts;
+    LatencyWindow latencies;
+    std::atomic<uint64_t> attempts{0}, retries{0}, timeouts{0}, hedges{0}, hedge_wins{0}, failed{0};
+
+    static double since(Clock::time_point t) {
+        return std::chrono::duration<double>(Clock::now() - t).count();
+    }
+
+    void backoff(int retry) {
+        thread_local std::mt19937 gen(std::random_device{}());
+        double cap = std::min(BACKOFF_CAP, BACKOFF_BASE * double(1 << std::min(retry, 20)));
+        std::this_thread::sleep_for(std::chrono::duration<double>(std::uniform_real_distribution<double>(0, cap)(gen)));
+    }
+
+    void count(const Outcome& o) {
+        if (o.result.curl_code == CURLE_OPERATION_TIMEDOUT)
+            timeouts++;
+    }
+
+    template <typename F>
+    Outcome streamed_attempt(CURL* curl, const std::string& node, F& on_neighbor, std::string* packed) {
+        Outcome o;
+        if (packed) packed->clear();
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, opts.timeout_ms);
+        try {
+            if (packed) {
+                PackNeighbors pack{packed};
+                o.result = stream_neighbors(curl, node, [&](std::string_view neighbor) {
+                    pack(neighbor);
+                    on_neighbor(neighbor);
+                });
+            } else {
+                o.result = stream_neighbors(curl, node, on_neighbor);
+            }
+        } catch (const ParseException& e) {
+            o.parse_error = std::current_exception();
+        }
+        return o;
+    }
+
+    void start(HedgeHandles& h, Transfer& t, const std::string& node) {
+        t.headers = prepare_neighbors_request(t.curl, node, &t.parser);
+        curl_easy_setopt(t.curl, CURLOPT_TIMEOUT_MS, opts.timeout_ms);
+        curl_multi_add_handle(h.multi, t.curl);
+        t.started = Clock::now();
+        t.used = true;
+        t.running = true;
+    }
+
+    void stop(HedgeHandles& h, Transfer& t) {
+        //removing a handle that is still transferring aborts it
+        curl_multi_remove_handle(h.multi, t.curl);
+        curl_slist_free_all(t.headers);
+        t.running = false;
+    }
+
+    Outcome finish(HedgeHandles& h, Transfer& t, CURLcode code, const std::string& node) {
+        Outcome o;
+        o.result.curl_code = code;
+        curl_easy_getinfo(t.curl, CURLINFO_RESPONSE_CODE, &o.result.http_code);
+        stop(h, t);
+        if (o.result.ok())
+            t.parser.finish();
+        if (t.parser.failed()) {
+            std::cerr<<"Error while parsing JSON response for: "<<node<<" at byte "<<t.parser.error_position()<<std::endl;
+            o.parse_error = std::make_exception_ptr(ParseException(t.parser.error_code(), t.parser.error_message(), t.parser.error_position()));
+        }
+        if (!o.result.ok())
+            std::cerr << "CURL error: " << curl_easy_strerror(code) << std::endl;
+        o.result.neighbors = t.parser.neighbors();
+        return o;
+    }
+
+    // Requests node on curl and, if that is still running after the hedge delay, on a second connection too.
+    // On success packed holds the neighbors of the response that completed first
+    Outcome hedged_attempt(CURL* curl, const std::string& node, std::string& packed) {
+        thread_local HedgeHandles h;
+        if (!h.multi) {
+            h.multi = curl_multi_init();
+            h.spare = curl_easy_init();
+            if (!h.multi || !h.spare) throw std::runtime_error("Failed to initialize CURL");
+        }
+
+        Transfer first(curl), second(h.spare);
+        double delay = latencies.percentile95();
+        start(h, first, node);
+
+        Outcome last;
+        Transfer* winner = nullptr;
+        while (!winner && (first.running || second.running)) {
+            int running;
+            curl_multi_perform(h.multi, &running);
+            CURLMsg* msg;
+            int msgs_left;
+            while (!winner && (msg = curl_multi_info_read(h.multi, &msgs_left))) {
+                if (msg->msg != CURLMSG_DONE) continue;
+                Transfer& t = msg->easy_handle == first.curl ? first : second;
+                Outcome o = finish(h, t, msg->data.result, node);
+                count(o);
+                if (o.ok()) {
+                    latencies.add(since(t.started));
+                    winner = &t;
+                }
+                last = o;
+            }
+            if (winner || (!first.running && !second.running)) break;
+
+            //only the first request gets a duplicate, and only while it is still running
+            double elapsed = since(first.started);
+            bool hedge_pending = first.running && !second.used && delay >= 0;
+            if (hedge_pending && elapsed >= delay) {
+                if (debug)
+                    std::cout << "Hedging request for " << node << " after " << elapsed << "s\n";
+                start(h, second, node);
+                hedges++;
+                attempts++;
+                continue;
+            }
+            int wait_ms = hedge_pending ? int((delay - elapsed) * 1000) + 1 : 1000;
+            curl_multi_poll(h.multi, nullptr, 0, wait_ms, nullptr);
+        }
+
+        if (first.running) stop(h, first);
+        if (second.running) stop(h, second);
+        if (winner) {
+            packed.swap(winner->packed);
+            if (winner == &second) hedge_wins++;
+        }
+        return last;
+    }
+
+    public:
+
+    RetryPolicy(const RetryOptions& options) : opts(options) {
+    }
+
+    RetryPolicy(const RetryPolicy&) = delete;
+    RetryPolicy& operator=(const RetryPolicy&) = delete;
+
+    // Fetches node's neighbors, retrying and hedging as configured, and calls on_neighbor(std::string_view) for
+    // each. Each attempt waits for a permit from limiter, if there is one; a hedged pair shares one permit.
+    // If packed is given, it ends up holding the neighbors of the attempt that succeeded. Returns the result of
+    // the last attempt. A malformed response that fails every attempt is thrown as a ParseException
+    template <typename F>
+    FetchResult fetch(CURL* curl, ConcurrencyLimiter* limiter, const std::string& node, F on_neighbor, std::string* packed) {
+        thread_local std::string buffer;
+        for (int attempt = 0; ; attempt++) {
+            if (attempt > 0) {
+                retries++;
+                backoff(attempt);
+            }
+            attempts++;
+
+            Outcome o;
+            {
+                ConcurrencyLimiter::Permit permit(limiter);
+                if (opts.hedge) {
+                    o = hedged_attempt(curl, node, buffer);
+                } else {
+                    o = streamed_attempt(curl, node, on_neighbor, packed);
+                    count(o);
+                }
+                permit.done(o.ok());
+            }
+
+            if (o.ok()) {
+                if (opts.hedge) {
+                    for_each_packed(buffer, on_neighbor);
+                    if (packed) packed->swap(buffer);
+                }
+                return o.result;
+            }
+            if (attempt >= opts.retries) {
+                failed++;
+                std::cerr << "Giving up on " << node << " after " << attempt + 1 << " attempts" << std::endl;
+                if (o.parse_error)
+                    std::rethrow_exception(o.parse_error);
+                return o.result;
+            }
+        }
+    }
+
+    // Requests made so far, every retry and hedge included
+    uint64_t attempts_made() const {
+        return attempts;
+    }
+
+    void print_stats(std::ostream& out) const {
+        out << "Fetch attempts: " << attempts << ", " << retries << " retries, " << timeouts << " timeouts, " << hedges
+            << " hedged (" << hedge_wins << " won by the hedge), " << failed << " nodes failed";
+        double p95 = latencies.percentile95();
+        if (opts.hedge && p95 >= 0)
+            out << ", hedge delay " << p95 * 1000 << "ms";
+        out << "\n";
+    }
+};
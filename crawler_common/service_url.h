@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+#include <cstdlib>
+
+// Base URL of the graph service's neighbors endpoint, shared by every crawler including the sequential ones.
+// Set HOLLYWOOD_GRAPH_URL to point the crawlers somewhere else, e.g. HOLLYWOOD_GRAPH_URL=http://localhost:8080
+// for the local mock server in mock_server/
+inline std::string service_url() {
+    const char* base = std::getenv("HOLLYWOOD_GRAPH_URL");
+    std::string url = (base && *base) ? base : "http://hollywood-graph-crawler.bridgesuncc.org";
+    while (!url.empty() && url.back() == '/')
+        url.pop_back();
+    return url + "/neighbors/";
+}
@@ -0,0 +1,436 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <queue>
+#include <memory>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+
+// Memory-bounded storage for level by level crawls too large to keep in memory. Levels live in files of sorted,
+// distinct names, and the only in-memory structures are fixed-size buffers carved out of a budget:
+// - the names found while expanding a level go into a buffer that is sorted, deduplicated and written out as a
+//   run whenever it fills up. Once the level is done, the runs are merged into one sorted stream
+// - the stream is checked against the visited set, which is the earlier level files. A Bloom filter of every
+//   visited name passes most new names straight through; the rest are collected and looked up on disk in sorted
+//   batches, walking each level file forward once per batch with a sparse index of every INDEX_STRIDE'th name
+// As the crawl grows past what the filter was sized for, more names take the disk lookup, but answers stay exact.
+// Files are named after the process ID in the spill directory and removed when their owner is destroyed
+
+struct SpillOptions {
+    size_t budget_bytes = 0;    //0: no spilling, everything stays in memory
+    std::string dir;            //empty: $TMPDIR or /tmp
+};
+
+inline const char* SPILL_OPTIONS_USAGE =
+    "  --memory-budget MB  keep the levels on disk, holding the crawl's own structures to about MB megabytes\n"
+    "  --spill-dir DIR     where to put the level files (default $TMPDIR or /tmp)\n";
+
+// Parses the spill option at argv[i], moving i past its value. Returns false if argv[i] is not a spill option
+inline bool parse_spill_option(int argc, char* argv[], int& i, SpillOptions& opts) {
+    std::string flag = argv[i];
+    if (flag != "--memory-budget" && flag != "--spill-dir") return false;
+    if (i + 1 >= argc) throw std::invalid_argument(flag + " needs a value");
+    std::string value = argv[++i];
+    if (flag == "--spill-dir") {
+        opts.dir = value;
+    } else {
+        double mb = std::stod(value);
+        if (mb < 1) throw std::invalid_argument("--memory-budget must be at least 1 MB");
+        opts.budget_bytes = size_t(mb * (1 << 20));
+    }
+    return true;
+}
+
+class BloomFilter {
+    static const int HASHES = 5;
+    std::vector<uint64_t> words;
+    uint64_t bits;
+
+    //the second hash is derived from the first, double hashing as in Kirsch and Mitzenmacher
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    public:
+
+    BloomFilter(size_t bytes) : words(std::max<size_t>(1, bytes / sizeof(uint64_t))), bits(words.size() * 64) {
+    }
+
+    void add(std::string_view s) {
+        uint64_t h1 = std::hash<std::string_view>()(s), h2 = mix(h1) | 1;
+        for (int k = 0; k < HASHES; k++) {
+            uint64_t bit = (h1 + k * h2) % bits;
+            words[bit / 64] |= uint64_t(1) << (bit % 64);
+        }
+    }
+
+    // False means s was never added, true that it may have been
+    bool maybe_contains(std::string_view s) const {
+        uint64_t h1 = std::hash<std::string_view>()(s), h2 = mix(h1) | 1;
+        for (int k = 0; k < HASHES; k++) {
+            uint64_t bit = (h1 + k * h2) % bits;
+            if (!(words[bit / 64] & (uint64_t(1) << (bit % 64)))) return false;
+        }
+        return true;
+    }
+};
+
+// Files of names, each stored as (uint32_t length, bytes)
+class NameWriter {
+    FILE* f;
+    std::string path;
+    uint64_t offset = 0;
+
+    public:
+
+    NameWriter(const std::string& path) : path(path) {
+        f = std::fopen(path.c_str(), "wb");
+        if (!f) throw std::runtime_error("Cannot write " + path + ": " + std::strerror(errno));
+    }
+
+    ~NameWriter() {
+        if (f) std::fclose(f);
+    }
+
+    NameWriter(const NameWriter&) = delete;
+    NameWriter& operator=(const NameWriter&) = delete;
+
+    void write(std::string_view s) {
+        uint32_t len = s.size();
+        if (std::fwrite(&len, sizeof(len), 1, f) != 1 || std::fwrite(s.data(), 1, s.size(), f) != s.size())
+            throw std::runtime_error("Cannot write " + path + ": " + std::strerror(errno));
+        offset += sizeof(len) + s.size();
+    }
+
+    // Where the next name will go
+    uint64_t position() const {
+        return offset;
+    }
+
+    void close() {
+        FILE* done = f;
+        f = nullptr;
+        if (std::fclose(done) != 0) throw std::runtime_error("Cannot write " + path + ": " + std::strerror(errno));
+    }
+};
+
+class NameReader {
+    FILE* f;
+    std::string path;
+
+    public:
+
+    NameReader(const std::string& path) : path(path) {
+        f = std::fopen(path.c_str(), "rb");
+        if (!f) throw std::runtime_error("Cannot read " + path + ": " + std::strerror(errno));
+    }
+
+    ~NameReader() {
+        std::fclose(f);
+    }
+
+    NameReader(const NameReader&) = delete;
+    NameReader& operator=(const NameReader&) = delete;
+
+    // Reads the next name into s. Returns false at the end of the file
+    bool next(std::string& s) {
+        uint32_t len;
+        if (std::fread(&len, sizeof(len), 1, f) != 1) return false;
+        s.resize(len);
+        if (std::fread(s.data(), 1, len, f) != len) throw std::runtime_error(path + " is truncated");
+        return true;
+    }
+
+    void seek(uint64_t offset) {
+        if (std::fseek(f, long(offset), SEEK_SET) != 0) throw std::runtime_error("Cannot seek in " + path);
+    }
+};
+
+// A file of sorted, distinct names, written once in order and then read back or searched
+class SortedNameFile {
+    static const uint64_t INDEX_STRIDE = 256;
+
+    std::string path;
+    std::unique_ptr<NameWriter> writer;
+    uint64_t count = 0;
+    //every INDEX_STRIDE'th name with its offset, the only part of the file kept in memory
+    std::vector<std::pair<std::string, uint64_t>> index;
+
+    public:
+
+    SortedNameFile(const std::string& path) : path(path), writer(new NameWriter(path)) {
+    }
+
+    ~SortedNameFile() {
+        writer.reset();
+        unlink(path.c_str());
+    }
+
+    SortedNameFile(const SortedNameFile&) = delete;
+    SortedNameFile& operator=(const SortedNameFile&) = delete;
+
+    // Appends s, which must sort after every name added so far
+    void add(std::string_view s) {
+        if (count % INDEX_STRIDE == 0)
+            index.emplace_back(std::string(s), writer->position());
+        writer->write(s);
+        count++;
+    }
+
+    // Ends writing, the file can be read from here on
+    void close() {
+        writer->close();
+        writer.reset();
+    }
+
+    uint64_t size() const {
+        return count;
+    }
+
+    // Calls f(batch) with the names in order, batch_bytes of names at a time. f may change batch_bytes
+    template <typename F>
+    void for_each_batch(size_t& batch_bytes, F f) const {
+        NameReader in(path);
+        std::vector<std::string> batch;
+        size_t bytes = 0;
+        std::string name;
+        while (in.next(name)) {
+            bytes += name.size();
+            batch.push_back(std::move(name));
+            if (bytes >= batch_bytes) {
+                f(batch);
+                batch.clear();
+                bytes = 0;
+            }
+        }
+        if (!batch.empty())
+            f(batch);
+    }
+
+    // Sets present[i] for every names[i] in the file, leaving the others as they are. names must be sorted
+    void lookup(const std::vector<std::string_view>& names, std::vector<bool>& present) const {
+        if (count == 0 || names.empty()) return;
+        NameReader in(path);
+        std::string current;
+        bool started = false, more = true;
+        for (size_t i = 0; i < names.size(); i++) {
+            std::string_view name = names[i];
+            //the last indexed name at or before name starts the block it would be in
+            auto block = std::upper_bound(index.begin(), index.end(), name, [](std::string_view s, const std::pair<std::string, uint64_t>& e) {
+                return s < std::string_view(e.first);
+            });
+            if (block == index.begin()) continue;
+            --block;
+            if (!started || (more && std::string_view(current) < std::string_view(block->first))) {
+                //skip ahead to the block instead of reading up to it
+                in.seek(block->second);
+                more = in.next(current);
+                started = true;
+            }
+            while (more && std::string_view(current) < name) {
+                more = in.next(current);
+            }
+            if (more && current == name)
+                present[i] = true;
+        }
+    }
+};
+
+// Collects names in a buffer of at most budget bytes, spilling it to a sorted run file whenever it fills up
+class NameRuns {
+    std::string prefix;
+    size_t budget;
+    std::string blob;
+    std::vector<std::pair<uint64_t, uint32_t>> entries;    //offset and length in blob
+    std::vector<std::string> runs;
+
+    std::string_view entry(const std::pair<uint64_t, uint32_t>& e) const {
+        return std::string_view(blob.data() + e.first, e.second);
+    }
+
+    void spill() {
+        if (entries.empty()) return;
+        std::sort(entries.begin(), entries.end(), [this](const auto& a, const auto& b) { return entry(a) < entry(b); });
+        std::string path = prefix + ".run" + std::to_string(runs.size());
+        runs.push_back(path);
+        NameWriter out(path);
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (i == 0 || entry(entries[i]) != entry(entries[i - 1]))
+                out.write(entry(entries[i]));
+        }
+        out.close();
+        blob.clear();
+        entries.clear();
+    }
+
+    public:
+
+    NameRuns(const std::string& prefix, size_t budget) : prefix(prefix), budget(budget) {
+    }
+
+    ~NameRuns() {
+        for (const std::string& run : runs) {
+            unlink(run.c_str());
+        }
+    }
+
+    NameRuns(const NameRuns&) = delete;
+    NameRuns& operator=(const NameRuns&) = delete;
+
+    void add(std::string_view s) {
+        if (blob.size() + s.size() + entries.size() * sizeof(entries[0]) > budget)
+            spill();
+        entries.emplace_back(blob.size(), uint32_t(s.size()));
+        blob.append(s);
+    }
+
+    size_t spilled() const {
+        return runs.size();
+    }
+
+    // Calls f(std::string_view) once for each distinct name added, in sorted order, merging the runs
+    template <typename F>
+    void merge(F f) {
+        spill();
+        std::vector<std::unique_ptr<NameReader>> readers;
+        std::vector<std::string> heads(runs.size());
+        //min-heap of run indexes by their current name
+        auto later = [&heads](size_t a, size_t b) { return heads[a] > heads[b]; };
+        std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heap(later);
+        for (size_t r = 0; r < runs.size(); r++) {
+            readers.emplace_back(new NameReader(runs[r]));
+            if (readers[r]->next(heads[r]))
+                heap.push(r);
+        }
+        std::string last;
+        bool any = false;
+        while (!heap.empty()) {
+            size_t r = heap.top();
+            heap.pop();
+            if (!any || heads[r] != last) {
+                f(std::string_view(heads[r]));
+                last = heads[r];
+                any = true;
+            }
+            if (readers[r]->next(heads[r]))
+                heap.push(r);
+        }
+    }
+};
+
+// The levels of a crawl on disk, with a Bloom filter of every name in them
+class SpilledLevels {
+    size_t budget;
+    std::string prefix;
+    BloomFilter bloom;
+    std::vector<std::unique_ptr<SortedNameFile>> levels;
+    uint64_t passed = 0, looked_up = 0, runs = 0;
+
+    public:
+
+    // A quarter of the budget goes to the Bloom filter, see run_bytes() and batch_bytes() for the rest
+    SpilledLevels(const SpillOptions& opts) : budget(opts.budget_bytes), bloom(opts.budget_bytes / 4) {
+        std::string dir = opts.dir;
+        if (dir.empty()) {
+            const char* tmp = std::getenv("TMPDIR");
+            dir = tmp && *tmp ? tmp : "/tmp";
+        }
+        prefix = dir + "/graphcrawler-" + std::to_string(getpid());
+    }
+
+    SpilledLevels(const SpilledLevels&) = delete;
+    SpilledLevels& operator=(const SpilledLevels&) = delete;
+
+    // Memory for the names found while expanding a level, before they are spilled
+    size_t run_bytes() const {
+        return budget / 2;
+    }
+
+    // Memory for a batch of a level being expanded, including what it finds
+    size_t batch_bytes() const {
+        return budget / 8;
+    }
+
+    // Level 0, the start node
+    void start(std::string_view name) {
+        levels.emplace_back(new SortedNameFile(prefix + ".level0"));
+        levels.back()->add(name);
+        levels.back()->close();
+        bloom.add(name);
+    }
+
+    // Where the runs for the next level go
+    std::string run_prefix() const {
+        return prefix + ".level" + std::to_string(levels.size());
+    }
+
+    // Adds the names in found that are in no level yet as the next level
+    void add_level(NameRuns& found) {
+        std::unique_ptr<SortedNameFile> next(new SortedNameFile(prefix + ".level" + std::to_string(levels.size())));
+
+        //names in merge order, and whether the filter sent them to the disk lookup. kept to about the same
+        //share of the budget as a batch
+        std::vector<std::string> pending;
+        std::vector<bool> maybe;
+        size_t pending_bytes = 0;
+        auto flush = [&]{
+            std::vector<std::string_view> check;
+            for (size_t i = 0; i < pending.size(); i++) {
+                if (maybe[i]) check.push_back(pending[i]);
+            }
+            std::vector<bool> present(check.size());
+            for (const auto& level : levels) {
+                level->lookup(check, present);
+            }
+            size_t c = 0;
+            for (size_t i = 0; i < pending.size(); i++) {
+                if (maybe[i] && present[c++]) continue;
+                next->add(pending[i]);
+                bloom.add(pending[i]);
+            }
+            looked_up += check.size();
+            passed += pending.size() - check.size();
+            pending.clear();
+            maybe.clear();
+            pending_bytes = 0;
+        };
+        found.merge([&](std::string_view name) {
+            maybe.push_back(bloom.maybe_contains(name));
+            pending.emplace_back(name);
+            pending_bytes += name.size() + sizeof(std::string);
+            if (pending_bytes >= batch_bytes())
+                flush();
+        });
+        flush();
+        runs += found.spilled();
+        next->close();
+        levels.push_back(std::move(next));
+    }
+
+    const SortedNameFile& level(size_t d) const {
+        return *levels[d];
+    }
+
+    size_t size() const {
+        return levels.size();
+    }
+
+    void print_stats(std::ostream& out) const {
+        out << "Spill: " << runs << " runs written, " << passed << " new names passed by the Bloom filter, "
+            << looked_up << " looked up on disk\n";
+    }
+};
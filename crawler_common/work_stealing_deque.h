@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Chase-Lev work-stealing deque of 64-bit items (Chase and Lev 2005, with the C11 memory orderings of
+// Le et al. 2013). The owning worker pushes and pops at the bottom without locks, LIFO, so it keeps working on
+// what it just discovered. Other workers steal from the top, FIFO, taking the oldest items. Owner and thieves
+// only race over the last item, and that race is settled with one CAS on top.
+// The ring buffer doubles when full. Thieves may still be reading an old buffer, so old buffers are kept
+// until the deque is destroyed
+
+class WorkStealingDeque {
+    struct Buffer {
+        int64_t capacity;
+        std::unique_ptr<std::atomic<uint64_t>[]> slots;
+
+        Buffer(int64_t capacity) : capacity(capacity), slots(new std::atomic<uint64_t>[capacity]) {}
+
+        uint64_t get(int64_t i) const {
+            return slots[i & (capacity - 1)].load(std::memory_order_relaxed);
+        }
+
+        void put(int64_t i, uint64_t x) {
+            slots[i & (capacity - 1)].store(x, std::memory_order_relaxed);
+        }
+    };
+
+    //top is written by thieves and bottom by the owner, keep them on separate cache lines
+    alignas(64) std::atomic<int64_t> top{0};
+    alignas(64) std::atomic<int64_t> bottom{0};
+    std::atomic<Buffer*> buffer;
+    std::vector<std::unique_ptr<Buffer>> buffers;
+
+    Buffer* grow(Buffer* old, int64_t t, int64_t b) {
+        buffers.push_back(std::make_unique<Buffer>(old->capacity * 2));
+        Buffer* bigger = buffers.back().get();
+        for(int64_t i = t; i < b; i++) bigger->put(i, old->get(i));
+        buffer.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+    public:
+
+    enum StealResult { EMPTY, LOST_RACE, STOLEN };
+
+    //owner only: pops that lost the race for the last item to a thief
+    uint64_t pop_conflicts = 0;
+
+    // capacity is rounded up to a power of two
+    WorkStealingDeque(int64_t initial_capacity = 256) {
+        int64_t capacity = 2;
+        while(capacity < initial_capacity) capacity *= 2;
+        buffers.push_back(std::make_unique<Buffer>(capacity));
+        buffer.store(buffers.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // Owner only
+    void push(uint64_t x) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        Buffer* a = buffer.load(std::memory_order_relaxed);
+        if(b - t > a->capacity - 1) a = grow(a, t, b);
+        a->put(b, x);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // Owner only. Returns false if the deque is empty
+    bool pop(uint64_t& x) {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Buffer* a = buffer.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        if(t > b) {
+            //was already empty
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        x = a->get(b);
+        if(t == b) {
+            //last item, thieves may be after it too
+            bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            if(!won) pop_conflicts++;
+            return won;
+        }
+        return true;
+    }
+
+    // Any thread
+    StealResult steal(uint64_t& x) {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if(t >= b) return EMPTY;
+
+        Buffer* a = buffer.load(std::memory_order_acquire);
+        x = a->get(t);
+        if(!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return LOST_RACE;
+        }
+        return STOLEN;
+    }
+
+    // Racy size, only a hint for other threads
+    int64_t size_hint() const {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_relaxed);
+        return b > t ? b - t : 0;
+    }
+};
@@ -2,245 +2,346 @@
 #include <thread>
 #include <mutex>
 #include <string>
-#include <queue>
+#include <vector>
 #include <condition_variable>
-#include <unordered_set>
-#include <cstdio>
-#include <cstdlib>
+#include <atomic>
+#include <memory>
+#include <random>
+#include <chrono>
+#include <cstdint>
 #include <curl/curl.h>
-#include <stdexcept>
-#include "rapidjson/error/error.h"
-#include "rapidjson/reader.h"
-
-
-struct ParseException : std::runtime_error, rapidjson::ParseResult {
-    ParseException(rapidjson::ParseErrorCode code, const char* msg, size_t offset) : 
-        std::runtime_error(msg), 
-        rapidjson::ParseResult(code, offset) {}
-};
-
-#define RAPIDJSON_PARSE_ERROR_NORETURN(code, offset) \
-    throw ParseException(code, #code, offset)
 
-#include <rapidjson/document.h>
-#include <chrono>
+#include "hollywood_client.h"
+#include "intern_table.h"
+#include "atomic_bitset.h"
+#include "work_stealing_deque.h"
+#include "neighbor_cache.h"
 
 
 bool debug = true;
 
-// Updated service URL
-const std::string SERVICE_URL = "http://hollywood-graph-crawler.bridgesuncc.org/neighbors/";
-
-template <typename T>
-class BlockingQueue {
-    std::queue<T> q;
-    std::mutex mut;
-    std::condition_variable queue_not_empty;
-    bool processing_complete = false;
-
+//a node is its ID in the intern table, so queue entries are 8 bytes instead of a string
+class Node {
     public:
-    
+    uint32_t id;
+    int depth;
 
-    BlockingQueue() {
-    }
+    Node() {}
 
-    void push(const T& element) {
-        std::unique_lock<std::mutex> lg(mut);
-        q.push(element);
-        queue_not_empty.notify_one();
+    Node(uint32_t id, int depth) {
+        this->id = id;
+        this-> depth = depth;
     }
+};
 
-    bool pop(T& t) {
-        std::unique_lock<std::mutex> lg(mut);
-        
-        //thread can be woken up spuriously, so the functor checks whether it should actually be awake every time it tries
-        queue_not_empty.wait(lg, [this]{ return !q.empty() || this->processing_complete; });
+// Work-stealing scheduler for the crawl.
+// Every worker has its own Chase-Lev deques, one per BFS depth. New neighbors go on the discovering worker's
+// deque for their depth. A per-depth count of queued nodes tells workers the shallowest depth that still has
+// work, and they only take nodes of that depth, so the crawl keeps the level order of a single shared queue.
+// A worker looks at other workers' deques only when its own have nothing at that depth: it then tries to
+// steal, starting at a random victim, and after a few failed rounds it parks on a condition variable until new
+// work is pushed.
+// Termination: pending counts nodes that were pushed and not yet done. Workers call done() after pushing a
+// node's neighbors, so pending only reaches zero when no work is queued and no worker is expanding.
+// In exact mode, workers only take nodes of the current level. Nodes of the next level are counted in
+// next_pending, and when the last node of the current level is done the level advances, so a node is always
+// claimed at its true BFS depth
+class WorkScheduler {
+    struct alignas(64) Counter {
+        std::atomic<int64_t> n{0};
+    };
 
-        if(processing_complete) return false;
+    struct alignas(64) Worker {
+        std::vector<std::unique_ptr<WorkStealingDeque>> by_depth;
+        std::minstd_rand rng;
+        uint64_t expanded = 0;
+        uint64_t steals = 0;
+        uint64_t failed_steals = 0;
+        uint64_t lost_races = 0;
+        uint64_t parks = 0;
+    };
 
-        t = q.front();
-        q.pop();
-        return true;
+    int n_workers;
+    int max_depth;
+    bool exact;
+    std::unique_ptr<Worker[]> workers;
+    std::unique_ptr<Counter[]> queued;
+    std::atomic<int64_t> pending{0};
+    std::atomic<int64_t> next_pending{0};
+    std::atomic<int> level{0};
+    std::atomic<bool> finished{false};
+
+    std::mutex park_mutex;
+    std::condition_variable work_available;
+    std::atomic<int> parked{0};
+
+    static uint64_t pack(const Node& node) {
+        return (uint64_t(node.id) << 32) | uint32_t(node.depth);
     }
 
-    void finish() {
-        std::unique_lock<std::mutex> lg(mut);
-        processing_complete = true;
-        queue_not_empty.notify_all();
-
+    static Node unpack(uint64_t x) {
+        return Node(uint32_t(x >> 32), int(uint32_t(x)));
     }
-};
 
-class Node {
-    public:
-    std::string value;
-    int depth;
-
-    Node() {}
-
-    Node(std::string value, int depth) {
-        this->value = value;
-        this-> depth = depth;
+    //deepest depth workers may take nodes from right now
+    int depth_limit() const {
+        if(exact) return level.load(std::memory_order_acquire);
+        for(int d = 0; d < max_depth; d++) {
+            if(queued[d].n.load(std::memory_order_acquire) > 0) return d;
+        }
+        return max_depth;
     }
 
-    bool operator== (const Node& node2) const {
-        return value == node2.value;
+    void taken(const Node& node) {
+        //workers parked while this depth had queued nodes wait for the next depth to open up
+        if(queued[node.depth].n.fetch_sub(1) == 1 && parked.load() > 0) wake_all();
     }
-};
 
-//the unordered set requires a hash function to be defined for an object to be used in it
-namespace std {
-    template <>
-    struct hash<Node> {
-        std::size_t operator()(const Node& n) const noexcept {
-            // use the existing string hasher
-            return std::hash<std::string>()(n.value);
+    void wake_one() {
+        //pairs with the fence in park(): either the parking worker sees the new node, or we see it parked
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(parked.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lg(park_mutex);
+            work_available.notify_one();
         }
-    };
-}
-
-// Function to HTTP ecnode parts of URLs. for instance, replace spaces with '%20' for URLs
-std::string url_encode(CURL* curl, std::string input) {
-  char* out = curl_easy_escape(curl, input.c_str(), input.size());
-  std::string s = out;
-  curl_free(out);
-  return s;
-}
-
-// Callback function for writing response data
-size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* output) {
-    size_t totalSize = size * nmemb;
-    output->append((char*)contents, totalSize);
-    return totalSize;
-}
+    }
 
-// Function to fetch neighbors using libcurl with debugging
-std::string fetch_neighbors(CURL* curl, const std::string& node) {
+    void wake_all() {
+        std::lock_guard<std::mutex> lg(park_mutex);
+        work_available.notify_all();
+    }
 
-  std::string url = SERVICE_URL + url_encode(curl, node);
-  std::string response;
+    bool any_queued(int limit) const {
+        for(int i = 0; i < n_workers; i++) {
+            for(int d = 0; d <= limit; d++) {
+                if(workers[i].by_depth[d]->size_hint() > 0) return true;
+            }
+        }
+        return false;
+    }
 
-    if (debug)
-      std::cout << "Sending request to: " << url << std::endl;
+    bool try_pop(Worker& self, int limit, uint64_t& x) {
+        for(int d = 0; d <= limit; d++) {
+            if(self.by_depth[d]->pop(x)) return true;
+        }
+        return false;
+    }
 
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    // curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L); // Verbose Logging
+    bool try_steal(Worker& self, int limit, uint64_t& x) {
+        int start = int(self.rng() % n_workers);
+        for(int k = 0; k < n_workers; k++) {
+            Worker& victim = workers[(start + k) % n_workers];
+            if(&victim == &self) continue;
+            for(int d = 0; d <= limit; d++) {
+                WorkStealingDeque::StealResult r = victim.by_depth[d]->steal(x);
+                if(r == WorkStealingDeque::STOLEN) {
+                    self.steals++;
+                    return true;
+                }
+                if(r == WorkStealingDeque::LOST_RACE) self.lost_races++;
+            }
+        }
+        self.failed_steals++;
+        return false;
+    }
 
-    // Set a User-Agent header to avoid potential blocking by the server
-    struct curl_slist* headers = nullptr;
-    headers = curl_slist_append(headers, "User-Agent: C++-Client/1.0");
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    void park(Worker& self, int limit) {
+        std::unique_lock<std::mutex> lg(park_mutex);
+        parked.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        self.parks++;
+        work_available.wait(lg, [&]{
+            return finished.load() || depth_limit() != limit || any_queued(limit);
+        });
+        parked.fetch_sub(1);
+    }
 
-    CURLcode res = curl_easy_perform(curl);
+    public:
 
-    if (res != CURLE_OK) {
-      std::cerr << "CURL error: " << curl_easy_strerror(res) << std::endl;
-    } else {
-      if (debug)
-        std::cout << "CURL request successful!" << std::endl;
+    WorkScheduler(int n_workers, int max_depth, bool exact)
+        : n_workers(n_workers), max_depth(max_depth), exact(exact), workers(new Worker[n_workers]),
+          queued(new Counter[max_depth + 1]) {
+        for(int i = 0; i < n_workers; i++) {
+            for(int d = 0; d <= max_depth; d++) {
+                workers[i].by_depth.push_back(std::make_unique<WorkStealingDeque>());
+            }
+            workers[i].rng.seed(i + 1);
+        }
     }
 
-    // Cleanup
-    curl_slist_free_all(headers);
+    // Queues the start node, before the workers start
+    void seed(const Node& node) {
+        pending.fetch_add(1);
+        queued[node.depth].n.fetch_add(1);
+        workers[0].by_depth[node.depth]->push(pack(node));
+    }
 
-    if (debug) 
-      std::cout << "Response received: " << response << std::endl;  // Debug log
+    // Called by worker w for a newly claimed node, at most max_depth deep
+    void push(int w, const Node& node) {
+        //count the node before it can be taken, so pending never drops to zero under it
+        if(exact) next_pending.fetch_add(1);
+        else pending.fetch_add(1);
+        queued[node.depth].n.fetch_add(1);
+        workers[w].by_depth[node.depth]->push(pack(node));
+        //in exact mode nobody can take it before the level advances, which wakes everyone anyway
+        if(!exact) wake_one();
+    }
 
-    return (res == CURLE_OK) ? response : "{}";
-}
+    // Gets worker w its next node. Returns false once the crawl is finished
+    bool next(int w, Node& node) {
+        Worker& self = workers[w];
+        const int STEAL_ROUNDS = 4;
+        uint64_t x;
+        while(!finished.load(std::memory_order_acquire)) {
+            int limit = depth_limit();
+            bool found = try_pop(self, limit, x);
+            for(int round = 0; !found && round < STEAL_ROUNDS; round++) {
+                found = try_steal(self, limit, x);
+                if(!found) std::this_thread::yield();
+            }
+            if(found) {
+                node = unpack(x);
+                taken(node);
+                self.expanded++;
+                return true;
+            }
+            park(self, limit);
+        }
+        return false;
+    }
 
-// Function to parse JSON and extract neighbors
-std::vector<std::string> get_neighbors(const std::string& json_str) {
-    std::vector<std::string> neighbors;
-    try {
-      rapidjson::Document doc;
-      doc.Parse(json_str.c_str());
-      
-      if (doc.HasMember("neighbors") && doc["neighbors"].IsArray()) {
-        for (const auto& neighbor : doc["neighbors"].GetArray())
-	        neighbors.push_back(neighbor.GetString());
-      }
-    } catch (const ParseException& e) {
-      std::cerr<<"Error while parsing JSON: "<<json_str<<std::endl;
-      throw e;
+    // Called by worker w after it has pushed all of a node's new neighbors
+    void done(int w) {
+        if(pending.fetch_sub(1) != 1) return;
+
+        //this was the last unfinished node of the crawl, or in exact mode of the level
+        int64_t next = exact ? next_pending.exchange(0) : 0;
+        if(next == 0) {
+            finished.store(true, std::memory_order_release);
+        } else {
+            pending.store(next);
+            level.fetch_add(1, std::memory_order_release);
+        }
+        wake_all();
     }
-    return neighbors;
-}
 
+    void print_stats(std::ostream& out) const {
+        uint64_t expanded = 0, steals = 0, failed = 0, lost = 0, parks = 0, pop_conflicts = 0;
+        uint64_t max_expanded = 0;
+        for(int i = 0; i < n_workers; i++) {
+            expanded += workers[i].expanded;
+            steals += workers[i].steals;
+            failed += workers[i].failed_steals;
+            lost += workers[i].lost_races;
+            parks += workers[i].parks;
+            for(auto& deque: workers[i].by_depth) pop_conflicts += deque->pop_conflicts;
+            max_expanded = std::max(max_expanded, workers[i].expanded);
+        }
+        out << "Nodes handed out: " << expanded << " (busiest worker " << max_expanded << "), steals: " << steals
+            << ", failed steal rounds: " << failed << ", lost steal races: " << lost
+            << ", lost pop races: " << pop_conflicts << ", parks: " << parks << "\n";
+    }
+};
 
 
-void expand_nodes(CURL* curl, BlockingQueue<Node>& q, std::unordered_set<Node>& visited, std::mutex& visited_mutex, const int& max_depth) {
-    auto id = std::this_thread::get_id();
 
-    while(true) {
-        Node to_expand;
 
-        if(!q.pop(to_expand))
-            break;
+void expand_nodes(int worker, CURL* curl, NeighborCache* cache, ConcurrencyLimiter* limiter, RetryPolicy& retry, WorkScheduler& work, InternTable& names, AtomicBitset& visited, const int& max_depth) {
+    auto id = std::this_thread::get_id();
+    Node to_expand;
 
-        if(to_expand.depth >= max_depth)
+    while(work.next(worker, to_expand)) {
+        if(to_expand.depth >= max_depth) {
+            work.done(worker);
             continue;
+        }
 
-
+        std::string name(names.name(to_expand.id));
         try {
             if (debug)
-                std::cout<<"Thread "<< id << " Trying to expand "<<to_expand.value<<"\n";
+                std::cout<<"Thread "<< id << " Trying to expand "<<name<<"\n";
 
-            //for each new neighbor
-            std::lock_guard<std::mutex> lg(visited_mutex);
-            for (const auto& neighbor : get_neighbors(fetch_neighbors(curl, to_expand.value))) {
+            //for each new neighbor, as its name comes off the wire. the fetch runs without any lock held, the
+            //visited check is one atomic bit
+            cached_neighbors(curl, cache, limiter, retry, name, [&](std::string_view neighbor) {
                 if (debug)
                     std::cout<<"neighbor "<<neighbor<<"\n";
 
-                Node neighbor_node = Node(neighbor, to_expand.depth+1);
-                if (!visited.count(neighbor_node)) {
-                    visited.insert(neighbor_node);
-                    q.push(neighbor_node);
+                uint32_t neighbor_id = names.intern(neighbor);
+                if (!visited.test_and_set(neighbor_id)) {
+                    work.push(worker, Node(neighbor_id, to_expand.depth+1));
                 }
-
-            }
+            });
         } catch (const ParseException& e) {
-            std::cerr<<"Error while fetching neighbors of: "<<to_expand.value<<std::endl;
+            std::cerr<<"Error while fetching neighbors of: "<<name<<std::endl;
             throw e;
         }
+        //only after the neighbors are queued, so the crawl never looks finished while work is still coming
+        work.done(worker);
 
     }
 }
 
 
 // BFS Traversal Function
-std::unordered_set<Node> bfs(std::vector<CURL*>& curl_handles, const std::string& start, int depth) {
-    int max_threads = curl_handles.size();
+// With exact set, nodes are expanded level by level (see WorkScheduler), otherwise in whatever order threads get to them
+std::vector<uint32_t> bfs(std::vector<CURL*>& curl_handles, NeighborCache* cache, ConcurrencyLimiter* limiter, RetryPolicy& retry, InternTable& names, const std::string& start, int depth, bool exact) {
     std::vector<std::thread> threadgroup;
-    std::unordered_set<Node> visited;
-    std::mutex visited_mutex;
-    BlockingQueue<Node> q;
+    AtomicBitset visited;
+    WorkScheduler work(curl_handles.size(), depth, exact);
 
     //add first node
-    q.push(Node(start, 0));
+    uint32_t start_id = names.intern(start);
+    visited.test_and_set(start_id);
+    work.seed(Node(start_id, 0));
 
-    for (CURL* handle: curl_handles) {
-        threadgroup.push_back(std::thread(expand_nodes, handle, std::ref(q), std::ref(visited), std::ref(visited_mutex), std::ref(depth)));
+    for (int i = 0; i < curl_handles.size(); i++) {
+        threadgroup.push_back(std::thread(expand_nodes, i, curl_handles[i], cache, limiter, std::ref(retry), std::ref(work), std::ref(names), std::ref(visited), std::ref(depth)));
     }
 
-    std::this_thread::sleep_for(std::chrono::seconds(15));
-    std::cout << "Finished waiting\n";
-    q.finish();
-
-    //recover all threads
+    //recover all threads, they return once the scheduler has detected that the crawl is finished
     for(auto& t: threadgroup) {
         t.join();
     }
-    
-    return visited;
+    work.print_stats(std::cout);
+
+    std::vector<uint32_t> nodes;
+    visited.for_each([&](uint32_t node) { nodes.push_back(node); });
+    return nodes;
+}
+
+void usage(const char* program) {
+    std::cerr << "Usage: " << program << " <node_name> <depth> <max_threads> [--exact] [cache options] [limiter options] [retry options]\n"
+              << CACHE_OPTIONS_USAGE
+              << LIMITER_OPTIONS_USAGE
+              << RETRY_OPTIONS_USAGE;
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 4) {
-        std::cerr << "Usage: " << argv[0] << " <node_name> <depth> <max_threads>\n";
+    if (argc < 4) {
+        usage(argv[0]);
+        return 1;
+    }
+    bool exact = false;
+    CacheOptions cache_options;
+    LimiterOptions limiter_options;
+    RetryOptions retry_options;
+    try {
+        for (int i = 4; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--exact")
+                exact = true;
+            else if (!parse_cache_option(argc, argv, i, cache_options) && !parse_limiter_option(argc, argv, i, limiter_options)
+                     && !parse_retry_option(argc, argv, i, retry_options))
+                throw std::invalid_argument("unknown option " + arg);
+        }
+        if (cache_options.cache_only && cache_options.path.empty())
+            throw std::invalid_argument("--cache-only needs --cache");
+        if (cache_options.ttl_seconds >= 0 && cache_options.path.empty())
+            throw std::invalid_argument("--cache-ttl needs --cache");
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        usage(argv[0]);
         return 1;
     }
 
@@ -259,6 +360,10 @@ int main(int argc, char* argv[]) {
         std::cerr << "Error: Max threads must be an integer.\n";
         return 1;
     }
+    if (max_threads <= 0) {
+        std::cerr << "Error: Max threads must be positive.\n";
+        return 1;
+    }
 
     //create a curl handle for each thread
     std::vector<CURL*> curl_handles;
@@ -276,17 +381,38 @@ int main(int argc, char* argv[]) {
     //time execution
     const auto start{std::chrono::steady_clock::now()};
     
-    std::unordered_set<Node> nodes= bfs(curl_handles, start_node, depth);
+    //opening the cache indexes it, which counts as part of the crawl
+    std::unique_ptr<NeighborCache> cache;
+    try {
+        if (!cache_options.path.empty())
+            cache.reset(new NeighborCache(cache_options));
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    std::unique_ptr<ConcurrencyLimiter> limiter;
+    if (limiter_options.adaptive || limiter_options.max_rate > 0)
+        limiter.reset(new ConcurrencyLimiter(limiter_options, max_threads));
+    RetryPolicy retry(retry_options);
+
+    InternTable names;
+    std::vector<uint32_t> nodes = bfs(curl_handles, cache.get(), limiter.get(), retry, names, start_node, depth, exact);
     
     const auto finish{std::chrono::steady_clock::now()};
     const std::chrono::duration<double> elapsed_seconds{finish - start};
 
     //print results
-    for (const auto& node : nodes) {
-	    std::cout << "- " << node.value << "\n";
+    for (uint32_t node : nodes) {
+	    std::cout << "- " << names.name(node) << "\n";
     }
     std::cout<<nodes.size()<<"\n";
     std::cout << "Time to crawl: "<<elapsed_seconds.count() << "s\n";
+    if (cache)
+        cache->print_stats(std::cout);
+    if (limiter)
+        limiter->print_stats(std::cout);
+    retry.print_stats(std::cout);
     
     //cleanup all the handles
     for(CURL* curl: curl_handles) {
@@ -21,14 +21,14 @@ struct ParseException : std::runtime_error, rapidjson::ParseResult {
 
 #include <rapidjson/document.h>
 #include <chrono>
+#include "../../crawler_common/service_url.h"
 
 using namespace std;
 using namespace rapidjson;
 
 bool debug = true;
 
-// Updated service URL
-const string SERVICE_URL = "http://hollywood-graph-crawler.bridgesuncc.org/neighbors/";
+const string SERVICE_URL = service_url();
 
 // Function to HTTP ecnode parts of URLs. for instance, replace spaces with '%20' for URLs
 string url_encode(CURL* curl, string input) {
@@ -0,0 +1,6 @@
+#!/bin/bash
+#SBATCH --job-name=event-graphcrawler
+#SBATCH --partition=Centaurus
+#SBATCH --time=10:00:00
+#SBATCH --mem=10G
+$HOME/parallelProgramming/event_graphcrawler/event-graphcrawler "$1" $2 $3
@@ -0,0 +1,102 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <chrono>
+#include <curl/curl.h>
+
+#include "hollywood_client.h"
+#include "multi_fetcher.h"
+
+
+bool debug = false;
+
+// BFS Traversal Function
+// Level-synchronous like level_client, but every node of a level is fetched concurrently through the
+// curl_multi event loop, with up to max_in_flight requests open at once. Responses are parsed in the
+// completion callback as soon as they arrive
+std::vector<std::vector<std::string>> bfs(MultiFetcher& fetcher, const std::string& start, int depth) {
+    std::vector<std::vector<std::string>> levels;
+    std::unordered_set<std::string> visited;
+
+    levels.push_back({start});
+    visited.insert(start);
+
+    for (int d = 0; d < depth; d++) {
+        if (debug)
+            std::cout<<"starting level: "<<d<<"\n";
+        levels.push_back({});
+
+        for (const std::string& s : levels[d]) {
+            fetcher.fetch(s, [&](const std::string& node, CURLcode result, long http_code, std::string& body) {
+                try {
+                    for (const auto& neighbor : get_neighbors(MultiFetcher::failed(result, http_code) ? "{}" : body)) {
+                        if (debug)
+                            std::cout<<"neighbor "<<neighbor<<"\n";
+                        if (!visited.count(neighbor)) {
+                            visited.insert(neighbor);
+                            levels[d+1].push_back(neighbor);
+                        }
+                    }
+                } catch (const ParseException& e) {
+                    std::cerr<<"Error while fetching neighbors of: "<<node<<std::endl;
+                    throw e;
+                }
+            });
+        }
+
+        //wait for the whole level, the event loop keeps max_in_flight requests open the whole time
+        fetcher.run();
+    }
+
+    return levels;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 4) {
+        std::cerr << "Usage: " << argv[0] << " <node_name> <depth> <max_in_flight>\n";
+        return 1;
+    }
+
+    std::string start_node = argv[1];     // example "Tom%20Hanks"
+    int depth;
+    try {
+        depth = std::stoi(argv[2]);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: Depth must be an integer.\n";
+        return 1;
+    }
+    int max_in_flight;
+    try {
+        max_in_flight = std::stoi(argv[3]);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: Max in flight must be an integer.\n";
+        return 1;
+    }
+    if (max_in_flight <= 0) {
+        std::cerr << "Error: Max in flight must be positive.\n";
+        return 1;
+    }
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    MultiFetcher fetcher(max_in_flight);
+
+
+    const auto start{std::chrono::steady_clock::now()};
+    
+    
+    for (const auto& n : bfs(fetcher, start_node, depth)) {
+        for (const auto& node : n)
+            std::cout << "- " << node << "\n";
+        std::cout<<n.size()<<"\n";
+    }
+    
+    const auto finish{std::chrono::steady_clock::now()};
+    const std::chrono::duration<double> elapsed_seconds{finish - start};
+    std::cout << "Time to crawl: "<<elapsed_seconds.count() << "s\n";
+    fetcher.print_stats(std::cout);
+
+    curl_global_cleanup();
+    
+    return 0;
+}
@@ -0,0 +1,41 @@
+#!/bin/bash
+# Compares answering the same BFS query by crawling again, with level_client and par-graphcrawler through a local
+# mock-server, against graph-analytics on a graph exported once with par-graphcrawler --export-csr.
+# Usage: ./bench_analytics.sh [start_node] [depth] [latency_ms] [jitter_ms] [threads] [repeat] [port]
+# Build par-graphcrawler, level_client, mock_server and graph-analytics first
+START=${1:-"Actor 0"}
+DEPTH=${2:-2}
+LATENCY=${3:-20}
+JITTER=${4:-5}
+THREADS=${5:-16}
+REPEAT=${6:-10}
+PORT=${7:-18080}
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+OUT=$(mktemp -d)
+
+$ROOT/mock_server/mock-server --port $PORT --latency-ms $LATENCY --jitter-ms $JITTER 2> $OUT/server.log &
+SERVER=$!
+trap "kill $SERVER 2> /dev/null; rm -rf $OUT" EXIT
+sleep 2
+export HOLLYWOOD_GRAPH_URL=http://localhost:$PORT
+
+run() {
+    name=$1
+    label=$2
+    shift 2
+    "$@" > $OUT/$name.txt 2> /dev/null
+    nodes=$(grep "^- " $OUT/$name.txt | sort -u | wc -l)
+    time=$(grep "$label" $OUT/$name.txt | sed "s/$label: //;s/s$//")
+    echo "$name,$nodes,$time"
+}
+
+echo "start=\"$START\" depth=$DEPTH latency=${LATENCY}ms jitter=${JITTER}ms threads=$THREADS"
+echo "method,distinct_nodes,time"
+run level_client "Time to crawl" $ROOT/par-graphcrawler/level_client "$START" $DEPTH
+run par-graphcrawler "Time to crawl" $ROOT/par-graphcrawler/par-graphcrawler "$START" $DEPTH $THREADS --export-csr $OUT/graph.csr
+#best of REPEAT runs on the exported graph, after it is in the page cache
+run graph-analytics "Time to BFS" $ROOT/graph_analytics/graph-analytics $OUT/graph.csr "$START" $DEPTH $THREADS --print-levels --repeat $REPEAT
+run graph-analytics-1-thread "Time to BFS" $ROOT/graph_analytics/graph-analytics $OUT/graph.csr "$START" $DEPTH 1 --print-levels --repeat $REPEAT
+kill -INT $SERVER
+wait $SERVER 2> /dev/null
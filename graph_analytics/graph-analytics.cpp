@@ -0,0 +1,400 @@
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <chrono>
+
+#include "csr_graph.h"
+
+// Offline analytics over a graph exported with par-graphcrawler --export-csr: BFS levels, connected components
+// and the degree distribution, all in memory and in parallel, so they can be rerun without the service
+
+
+// Threads that live as long as the team and run one parallel loop at a time, for the many short loops of the
+// analytics. run() splits [0, n) into chunks taken from a shared counter, so nodes of uneven degree balance out.
+// The calling thread is thread 0 and works too
+class ThreadTeam {
+    std::vector<std::thread> threads;
+    std::mutex mut;
+    std::condition_variable loop_ready;
+    std::condition_variable loop_finished;
+    uint64_t generation = 0;
+    int busy = 0;
+    bool stopping = false;
+
+    //the current loop, only changed while no thread is busy
+    std::function<void(size_t, size_t, int)> body;
+    size_t total = 0;
+    size_t chunk = 1;
+    std::atomic<size_t> next_index{0};
+
+    void work(int t) {
+        size_t first;
+        while ((first = next_index.fetch_add(chunk, std::memory_order_relaxed)) < total) {
+            body(first, std::min(total, first + chunk), t);
+        }
+    }
+
+    void loop(int t) {
+        uint64_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lg(mut);
+                loop_ready.wait(lg, [&]{ return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+            }
+            work(t);
+            std::lock_guard<std::mutex> lg(mut);
+            if (--busy == 0)
+                loop_finished.notify_one();
+        }
+    }
+
+    public:
+
+    ThreadTeam(int n) {
+        for (int t = 1; t < n; t++) {
+            threads.emplace_back(&ThreadTeam::loop, this, t);
+        }
+    }
+
+    ~ThreadTeam() {
+        {
+            std::lock_guard<std::mutex> lg(mut);
+            stopping = true;
+        }
+        loop_ready.notify_all();
+        for (std::thread& t : threads) {
+            t.join();
+        }
+    }
+
+    int size() const {
+        return threads.size() + 1;
+    }
+
+    // Calls f(first, last, thread) over chunks covering [0, n), returning once all are done
+    template <typename F>
+    void run(size_t n, F f) {
+        {
+            std::lock_guard<std::mutex> lg(mut);
+            body = f;
+            total = n;
+            chunk = std::max<size_t>(256, n / (8 * size()));
+            next_index.store(0, std::memory_order_relaxed);
+            busy = threads.size();
+            generation++;
+        }
+        loop_ready.notify_all();
+        work(0);
+        std::unique_lock<std::mutex> lg(mut);
+        loop_finished.wait(lg, [this]{ return busy == 0; });
+    }
+};
+
+// Fixed-size concurrent bitmap over node IDs
+class Bitmap {
+    std::vector<std::atomic<uint64_t>> words;
+
+    public:
+
+    Bitmap(size_t bits) : words((bits + 63) / 64) {
+        clear();
+    }
+
+    void clear() {
+        for (auto& w : words) {
+            w.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    bool test(uint32_t i) const {
+        return words[i / 64].load(std::memory_order_relaxed) & (uint64_t(1) << (i % 64));
+    }
+
+    // Sets bit i and returns its previous value
+    bool test_and_set(uint32_t i) {
+        uint64_t bit = uint64_t(1) << (i % 64);
+        if (words[i / 64].load(std::memory_order_relaxed) & bit) return true;
+        return words[i / 64].fetch_or(bit, std::memory_order_relaxed) & bit;
+    }
+};
+
+struct BfsResult {
+    std::vector<std::vector<uint32_t>> levels;
+    int top_down = 0;
+    int bottom_up = 0;
+};
+
+// Direction-optimizing BFS (Beamer, Asanovic and Patterson). A top-down step expands the frontier's edges, which
+// is cheap while the frontier is small. Once the frontier's edges outnumber the unvisited nodes' edges by ALPHA,
+// bottom-up steps take over: every unvisited node looks for any neighbor in the frontier bitmap and stops at the
+// first, so the big middle levels skip most of their edges. When the frontier shrinks under 1/BETA of the nodes
+// it goes back to top-down. Levels up to depth are returned, with the nodes of each level in no particular order
+BfsResult direction_optimizing_bfs(const CsrGraph& g, ThreadTeam& team, uint32_t source, int depth) {
+    static const double ALPHA = 14;
+    static const double BETA = 24;
+
+    uint32_t n = g.nodes();
+    Bitmap visited(n), frontier_bits(n);
+    std::vector<std::vector<uint32_t>> found(team.size());
+    std::vector<uint64_t> found_edges(team.size());
+
+    BfsResult result;
+    result.levels.push_back({source});
+    visited.test_and_set(source);
+    uint64_t frontier_edges = g.degree(source);
+    uint64_t unvisited_edges = g.edges() - frontier_edges;
+    bool bottom_up = false;
+
+    for (int d = 0; d < depth && !result.levels[d].empty(); d++) {
+        const std::vector<uint32_t>& frontier = result.levels[d];
+        if (!bottom_up && frontier_edges > unvisited_edges / ALPHA)
+            bottom_up = true;
+        else if (bottom_up && frontier.size() < n / BETA)
+            bottom_up = false;
+
+        if (bottom_up) {
+            result.bottom_up++;
+            frontier_bits.clear();
+            for (uint32_t u : frontier)
+                frontier_bits.test_and_set(u);
+            team.run(n, [&](size_t first, size_t last, int t) {
+                for (size_t v = first; v < last; v++) {
+                    if (visited.test(v)) continue;
+                    for (uint32_t u : g.neighbors(v)) {
+                        if (frontier_bits.test(u)) {
+                            //v is only looked at by this thread, but its bitmap word is shared
+                            visited.test_and_set(v);
+                            found[t].push_back(v);
+                            found_edges[t] += g.degree(v);
+                            break;
+                        }
+                    }
+                }
+            });
+        } else {
+            result.top_down++;
+            team.run(frontier.size(), [&](size_t first, size_t last, int t) {
+                for (size_t i = first; i < last; i++) {
+                    for (uint32_t v : g.neighbors(frontier[i])) {
+                        //only the thread that flips the bit claims v
+                        if (!visited.test_and_set(v)) {
+                            found[t].push_back(v);
+                            found_edges[t] += g.degree(v);
+                        }
+                    }
+                }
+            });
+        }
+
+        std::vector<uint32_t> next;
+        frontier_edges = 0;
+        for (int t = 0; t < team.size(); t++) {
+            next.insert(next.end(), found[t].begin(), found[t].end());
+            found[t].clear();
+            frontier_edges += found_edges[t];
+            found_edges[t] = 0;
+        }
+        unvisited_edges -= frontier_edges;
+        result.levels.push_back(std::move(next));
+    }
+    if (result.levels.back().empty())
+        result.levels.pop_back();
+    return result;
+}
+
+struct Components {
+    uint32_t count = 0;
+    uint32_t largest = 0;
+    int rounds = 0;
+};
+
+// Connected components by label propagation: every node starts with its own ID as label and takes the smallest
+// label among its neighbors until no label changes, so each component ends up labeled with its smallest ID.
+// Labels are updated in place, so a round already sees labels lowered earlier in the same round
+Components connected_components(const CsrGraph& g, ThreadTeam& team) {
+    uint32_t n = g.nodes();
+    std::vector<std::atomic<uint32_t>> label(n);
+    team.run(n, [&](size_t first, size_t last, int) {
+        for (size_t v = first; v < last; v++)
+            label[v].store(v, std::memory_order_relaxed);
+    });
+
+    Components result;
+    std::atomic<bool> changed;
+    do {
+        changed.store(false, std::memory_order_relaxed);
+        team.run(n, [&](size_t first, size_t last, int) {
+            bool any = false;
+            for (size_t v = first; v < last; v++) {
+                uint32_t current = label[v].load(std::memory_order_relaxed);
+                uint32_t best = current;
+                for (uint32_t u : g.neighbors(v))
+                    best = std::min(best, label[u].load(std::memory_order_relaxed));
+                if (best < current) {
+                    label[v].store(best, std::memory_order_relaxed);
+                    any = true;
+                }
+            }
+            if (any)
+                changed.store(true, std::memory_order_relaxed);
+        });
+        result.rounds++;
+    } while (changed.load());
+
+    std::vector<uint32_t> size(n);
+    for (uint32_t v = 0; v < n; v++) {
+        uint32_t l = label[v].load(std::memory_order_relaxed);
+        if (l == v) result.count++;
+        result.largest = std::max(result.largest, ++size[l]);
+    }
+    return result;
+}
+
+struct DegreeHistogram {
+    //buckets[0] counts degree 0, buckets[b] degrees 2^(b-1) .. 2^b - 1
+    std::vector<uint64_t> buckets;
+    size_t max = 0;
+    uint64_t total = 0;
+};
+
+// Degree distribution in power of two buckets, each thread counting into its own histogram
+DegreeHistogram degree_histogram(const CsrGraph& g, ThreadTeam& team) {
+    std::vector<DegreeHistogram> local(team.size());
+    for (DegreeHistogram& h : local)
+        h.buckets.assign(65, 0);
+    team.run(g.nodes(), [&](size_t first, size_t last, int t) {
+        DegreeHistogram& h = local[t];
+        for (size_t v = first; v < last; v++) {
+            size_t d = g.degree(v);
+            h.buckets[d == 0 ? 0 : 64 - __builtin_clzll(d)]++;
+            h.max = std::max(h.max, d);
+            h.total += d;
+        }
+    });
+
+    DegreeHistogram result = local[0];
+    for (int t = 1; t < team.size(); t++) {
+        for (size_t b = 0; b < result.buckets.size(); b++)
+            result.buckets[b] += local[t].buckets[b];
+        result.max = std::max(result.max, local[t].max);
+        result.total += local[t].total;
+    }
+    while (result.buckets.size() > 1 && result.buckets.back() == 0)
+        result.buckets.pop_back();
+    return result;
+}
+
+// Runs f repeat times and returns the best time in seconds
+template <typename F>
+double best_of(int repeat, F f) {
+    double best = 0;
+    for (int r = 0; r < repeat; r++) {
+        const auto start{std::chrono::steady_clock::now()};
+        f();
+        const std::chrono::duration<double> t{std::chrono::steady_clock::now() - start};
+        if (r == 0 || t.count() < best)
+            best = t.count();
+    }
+    return best;
+}
+
+void usage(const char* program) {
+    std::cerr << "Usage: " << program << " <graph.csr> <node_name> <depth> <threads> [--print-levels] [--repeat N]\n"
+              << "  --print-levels       print the BFS levels like the crawlers do\n"
+              << "  --repeat N           run every analysis N times and report the best time (default 1)\n";
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 5) {
+        usage(argv[0]);
+        return 1;
+    }
+    bool print_levels = false;
+    int repeat = 1;
+    int depth, threads;
+    try {
+        depth = std::stoi(argv[3]);
+        threads = std::stoi(argv[4]);
+        for (int i = 5; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--print-levels")
+                print_levels = true;
+            else if (arg == "--repeat" && i + 1 < argc)
+                repeat = std::stoi(argv[++i]);
+            else
+                throw std::invalid_argument("unknown option " + arg);
+        }
+        if (threads < 1 || repeat < 1)
+            throw std::invalid_argument("threads and --repeat must be positive");
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        usage(argv[0]);
+        return 1;
+    }
+
+    const auto start{std::chrono::steady_clock::now()};
+    std::unique_ptr<CsrGraph> graph;
+    try {
+        graph.reset(new CsrGraph(argv[1]));
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    const CsrGraph& g = *graph;
+    const std::chrono::duration<double> open_seconds{std::chrono::steady_clock::now() - start};
+    std::cout << "Graph: " << g.nodes() << " nodes, " << g.edges() / 2 << " edges, opened in " << open_seconds.count() << "s\n";
+
+    uint32_t source;
+    if (!g.find(argv[2], source)) {
+        std::cerr << "Error: " << argv[2] << " is not in the graph\n";
+        return 1;
+    }
+    ThreadTeam team(threads);
+
+    BfsResult bfs;
+    double bfs_seconds = best_of(repeat, [&]{ bfs = direction_optimizing_bfs(g, team, source, depth); });
+    if (print_levels) {
+        for (const auto& level : bfs.levels) {
+            for (uint32_t v : level)
+                std::cout << "- " << g.name(v) << "\n";
+            std::cout << level.size() << "\n";
+        }
+    }
+    size_t reached = 0;
+    std::cout << "BFS levels:";
+    for (const auto& level : bfs.levels) {
+        std::cout << " " << level.size();
+        reached += level.size();
+    }
+    std::cout << " (" << reached << " nodes), " << bfs.top_down << " top-down and " << bfs.bottom_up << " bottom-up steps\n";
+    std::cout << "Time to BFS: " << bfs_seconds << "s\n";
+
+    Components cc;
+    double cc_seconds = best_of(repeat, [&]{ cc = connected_components(g, team); });
+    std::cout << "Components: " << cc.count << ", the largest with " << cc.largest << " nodes, " << cc.rounds << " label propagation rounds\n";
+    std::cout << "Time to find components: " << cc_seconds << "s\n";
+
+    DegreeHistogram degrees;
+    double degree_seconds = best_of(repeat, [&]{ degrees = degree_histogram(g, team); });
+    std::cout << "Degrees: max " << degrees.max << ", mean " << (g.nodes() ? double(degrees.total) / g.nodes() : 0) << "\n";
+    for (size_t b = 0; b < degrees.buckets.size(); b++) {
+        if (b <= 1)
+            std::cout << "  " << b;
+        else
+            std::cout << "  " << (size_t(1) << (b - 1)) << "-" << (size_t(1) << b) - 1;
+        std::cout << ": " << degrees.buckets[b] << "\n";
+    }
+    std::cout << "Time to count degrees: " << degree_seconds << "s\n";
+
+    return 0;
+}
@@ -0,0 +1,40 @@
+#!/bin/bash
+# Crawls the same synthetic graph with every crawler through a local mock-server, so the timings only
+# depend on the crawler and the simulated latency.
+# Usage: ./bench_crawlers.sh [start_node] [depth] [latency_ms] [jitter_ms] [parallelism] [port]
+# parallelism is the thread count for par-graphcrawler and queue-graphcrawler, and 8x that many requests
+# in flight for event-graphcrawler. Build the crawlers and mock_server first
+START=${1:-"Actor 0"}
+DEPTH=${2:-2}
+LATENCY=${3:-20}
+JITTER=${4:-5}
+PARALLELISM=${5:-16}
+PORT=${6:-18080}
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+OUT=$(mktemp -d)
+
+$ROOT/mock_server/mock-server --port $PORT --latency-ms $LATENCY --jitter-ms $JITTER 2> $OUT/server.log &
+SERVER=$!
+trap "kill $SERVER 2> /dev/null; rm -rf $OUT" EXIT
+sleep 2
+export HOLLYWOOD_GRAPH_URL=http://localhost:$PORT
+
+run() {
+    name=$1
+    shift
+    "$@" > $OUT/$name.txt 2> /dev/null
+    nodes=$(grep "^- " $OUT/$name.txt | sort -u | wc -l)
+    time=$(grep "Time to crawl" $OUT/$name.txt | sed 's/Time to crawl: //')
+    echo "$name,$nodes,$time"
+}
+
+echo "start=\"$START\" depth=$DEPTH latency=${LATENCY}ms jitter=${JITTER}ms parallelism=$PARALLELISM"
+echo "crawler,distinct_nodes,time"
+run level_client $ROOT/par-graphcrawler/level_client "$START" $DEPTH
+run par-graphcrawler $ROOT/par-graphcrawler/par-graphcrawler "$START" $DEPTH $PARALLELISM
+run queue-graphcrawler $ROOT/dynamic_work_graphcrawler/queue-graphcrawler "$START" $DEPTH $PARALLELISM
+run event-graphcrawler $ROOT/event_graphcrawler/event-graphcrawler "$START" $DEPTH $((PARALLELISM * 8))
+kill -INT $SERVER
+wait $SERVER 2> /dev/null
+tail -1 $OUT/server.log
@@ -0,0 +1,54 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <chrono>
+
+#include "synthetic_graph.h"
+
+// Writes a synthetic actor-movie graph as a tab separated edge list, which mock-server can load with --graph.
+// mock-server can also generate the graph itself from the same options, this is for keeping a fixed copy
+// or inspecting it
+
+void usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options] <output.tsv>\n" << GRAPH_OPTIONS_USAGE;
+}
+
+int main(int argc, char* argv[]) {
+    GraphParams params;
+    std::string out_path;
+    try {
+        for(int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if(arg.rfind("--", 0) == 0) {
+                if(i + 1 >= argc || !parse_graph_option(arg, argv[i+1], params)) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                i++;
+            } else {
+                out_path = arg;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: option values must be numbers.\n";
+        return 1;
+    }
+    if(out_path.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    SyntheticGraph g = generate_graph(params);
+    std::ofstream out(out_path);
+    if(!out) {
+        std::cerr << "Could not open " << out_path << "\n";
+        return 1;
+    }
+    write_edge_list(out, g);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    print_graph_summary(std::cout, g);
+    std::cout << "Wrote " << out_path << " in " << elapsed.count() << "s\n";
+    return 0;
+}
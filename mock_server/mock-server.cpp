@@ -0,0 +1,454 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <queue>
+#include <unordered_map>
+#include <random>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <cstdio>
+#include <cctype>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+
+#include "synthetic_graph.h"
+
+// Local stand-in for the Hollywood graph service, for benchmarking the crawlers without the network.
+// Serves GET /neighbors/<url encoded name> with the same JSON as the real service:
+//     {"node": "<name>", "neighbors": ["<name>", ...]}
+// from a generated graph (synthetic_graph.h) or an edge list file.
+// One thread runs an epoll loop over non-blocking sockets with HTTP/1.1 keep-alive, so it can hold thousands
+// of connections. Each response is held back for latency +/- jitter milliseconds without blocking the loop:
+// it waits in a queue ordered by due time, and the epoll timeout wakes the loop for the next one.
+// A fraction of requests (--error-rate) gets a 503 instead, to exercise the crawlers' error handling, and a
+// fraction (--slow-rate) is held back an extra --slow-ms, like a server stalling on the odd request.
+// With --capacity N the service handles at most N requests at a time and the rest queue for a free slot, so
+// latency grows with load as on a busy real server.
+// Point the crawlers at it with HOLLYWOOD_GRAPH_URL=http://localhost:<port>
+
+const size_t MAX_REQUEST_BYTES = 64 * 1024;
+
+struct ServerOptions {
+    int port = 8080;
+    std::string graph_file;
+    double latency_ms = 0;
+    double jitter_ms = 0;
+    double error_rate = 0;
+    int capacity = 0;           //requests handled at once, 0: unlimited
+    double slow_rate = 0;
+    double slow_ms = 1000;
+};
+
+struct PendingResponse {
+    int64_t due_ns;
+    std::string text;
+    bool close_after;
+};
+
+struct Connection {
+    int fd;
+    std::string in;
+    std::string out;
+    size_t out_sent = 0;
+    bool writing = false;
+    bool closing = false;
+    //responses go out in request order. due times are kept non-decreasing so the front is always due first
+    std::deque<PendingResponse> pending;
+};
+
+struct Wakeup {
+    int64_t due_ns;
+    uint64_t conn_id;
+
+    bool operator>(const Wakeup& other) const {
+        return due_ns > other.due_ns;
+    }
+};
+
+volatile std::sig_atomic_t stop_requested = 0;
+
+void handle_signal(int) {
+    stop_requested = 1;
+}
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::string url_decode(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    for(size_t i = 0; i < s.size(); i++) {
+        if(s[i] == '%' && i + 2 < s.size() && isxdigit((unsigned char)s[i+1]) && isxdigit((unsigned char)s[i+2])) {
+            out += char(std::stoi(s.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        } else {
+            out += s[i];
+        }
+    }
+    return out;
+}
+
+void append_json_string(std::string& out, const std::string& s) {
+    out += '"';
+    for(char c: s) {
+        switch(c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if((unsigned char)c < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+}
+
+std::string http_response(int status, const char* reason, const std::string& body, bool close_after) {
+    std::string r = "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n";
+    r += "Content-Type: application/json\r\n";
+    r += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    if(close_after) r += "Connection: close\r\n";
+    r += "\r\n";
+    r += body;
+    return r;
+}
+
+class MockServer {
+    const SyntheticGraph& graph;
+    ServerOptions options;
+    std::mt19937_64 gen;
+    int listen_fd = -1;
+    int epoll_fd = -1;
+    uint64_t next_conn_id = 1;
+    std::unordered_map<uint64_t, Connection> connections;
+    std::priority_queue<Wakeup, std::vector<Wakeup>, std::greater<Wakeup>> wakeups;
+    //with a capacity, when each of the busy slots frees up
+    std::priority_queue<int64_t, std::vector<int64_t>, std::greater<int64_t>> slots_free_at;
+
+    public:
+    uint64_t requests = 0;
+    uint64_t errors_injected = 0;
+    uint64_t slow_injected = 0;
+    uint64_t bad_requests = 0;
+
+    MockServer(const SyntheticGraph& graph, const ServerOptions& options, uint64_t seed) : graph(graph), options(options), gen(seed) {}
+
+    ~MockServer() {
+        for(auto& entry: connections) close(entry.second.fd);
+        if(listen_fd >= 0) close(listen_fd);
+        if(epoll_fd >= 0) close(epoll_fd);
+    }
+
+    void listen_on(int port) {
+        listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if(listen_fd < 0) throw std::runtime_error("socket failed");
+        int one = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(uint16_t(port));
+        if(bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listen_fd, SOMAXCONN) < 0) {
+            throw std::runtime_error(std::string("could not listen on port ") + std::to_string(port) + ": " + std::strerror(errno));
+        }
+
+        epoll_fd = epoll_create1(0);
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.u64 = 0; //connection ids start at 1, 0 is the listening socket
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev);
+    }
+
+    void run() {
+        const int MAX_EVENTS = 256;
+        epoll_event events[MAX_EVENTS];
+        while(!stop_requested) {
+            int timeout_ms = -1;
+            if(!wakeups.empty()) {
+                int64_t wait_ns = wakeups.top().due_ns - now_ns();
+                //round up, waking early would just loop again
+                timeout_ms = wait_ns <= 0 ? 0 : int((wait_ns + 999999) / 1000000);
+            }
+            int n = epoll_wait(epoll_fd, events, MAX_EVENTS, timeout_ms);
+            if(n < 0 && errno != EINTR) throw std::runtime_error("epoll_wait failed");
+
+            for(int i = 0; i < n; i++) {
+                uint64_t id = events[i].data.u64;
+                if(id == 0) {
+                    accept_all();
+                    continue;
+                }
+                if(events[i].events & (EPOLLERR | EPOLLHUP)) {
+                    drop(id);
+                    continue;
+                }
+                if(events[i].events & EPOLLIN) on_readable(id);
+                if(events[i].events & EPOLLOUT) flush(id);
+            }
+            release_due();
+        }
+    }
+
+    private:
+
+    void accept_all() {
+        while(true) {
+            int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK);
+            if(fd < 0) return;
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            uint64_t id = next_conn_id++;
+            Connection& c = connections[id];
+            c.fd = fd;
+            epoll_event ev = {};
+            ev.events = EPOLLIN;
+            ev.data.u64 = id;
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+        }
+    }
+
+    void drop(uint64_t id) {
+        auto it = connections.find(id);
+        if(it == connections.end()) return;
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+        close(it->second.fd);
+        //wakeups that still point at this id find nothing and are skipped
+        connections.erase(it);
+    }
+
+    void on_readable(uint64_t id) {
+        auto it = connections.find(id);
+        if(it == connections.end()) return;
+        Connection& c = it->second;
+        char buf[16384];
+        while(true) {
+            ssize_t got = recv(c.fd, buf, sizeof(buf), 0);
+            if(got > 0) {
+                c.in.append(buf, size_t(got));
+                continue;
+            }
+            if(got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                drop(id);
+                return;
+            }
+            break;
+        }
+
+        //a client may pipeline several requests in one read
+        size_t header_end;
+        while(!c.closing && (header_end = c.in.find("\r\n\r\n")) != std::string::npos) {
+            std::string head = c.in.substr(0, header_end);
+            c.in.erase(0, header_end + 4);
+            handle_request(c, id, head);
+        }
+        if(c.in.size() > MAX_REQUEST_BYTES) {
+            drop(id);
+        }
+    }
+
+    void handle_request(Connection& c, uint64_t id, const std::string& head) {
+        requests++;
+        size_t line_end = head.find("\r\n");
+        std::string request_line = head.substr(0, line_end);
+        std::string lower_head = head;
+        for(char& ch: lower_head) ch = char(std::tolower((unsigned char)ch));
+        bool close_after = lower_head.find("\r\nconnection: close") != std::string::npos
+                           || request_line.find("HTTP/1.0") != std::string::npos;
+
+        size_t sp1 = request_line.find(' ');
+        size_t sp2 = request_line.find(' ', sp1 + 1);
+        std::string method = request_line.substr(0, sp1);
+        std::string path = (sp1 == std::string::npos || sp2 == std::string::npos) ? "" : request_line.substr(sp1 + 1, sp2 - sp1 - 1);
+
+        const std::string prefix = "/neighbors/";
+        std::string text;
+        if(method != "GET" || path.rfind(prefix, 0) != 0) {
+            bad_requests++;
+            text = http_response(404, "Not Found", "{\"error\": \"unknown path\"}", close_after);
+        } else if(options.error_rate > 0 && std::uniform_real_distribution<double>(0, 1)(gen) < options.error_rate) {
+            errors_injected++;
+            text = http_response(503, "Service Unavailable", "{\"error\": \"injected failure\"}", close_after);
+        } else {
+            std::string name = url_decode(path.substr(prefix.size()));
+            //nodes that are not in the graph get an empty neighbor list
+            std::string body = "{\"node\": ";
+            append_json_string(body, name);
+            body += ", \"neighbors\": [";
+            if(const uint32_t* v = graph.find(name)) {
+                for(uint64_t e = graph.offsets[*v]; e < graph.offsets[*v + 1]; e++) {
+                    if(e != graph.offsets[*v]) body += ", ";
+                    append_json_string(body, graph.names[graph.neighbors[e]]);
+                }
+            }
+            body += "]}";
+            text = http_response(200, "OK", body, close_after);
+        }
+
+        double delay_ms = options.latency_ms;
+        if(options.jitter_ms > 0) {
+            delay_ms += std::uniform_real_distribution<double>(-options.jitter_ms, options.jitter_ms)(gen);
+        }
+        if(options.slow_rate > 0 && std::uniform_real_distribution<double>(0, 1)(gen) < options.slow_rate) {
+            slow_injected++;
+            delay_ms += options.slow_ms;
+        }
+        int64_t now = now_ns();
+        int64_t begin = now;
+        if(options.capacity > 0 && int(slots_free_at.size()) >= options.capacity) {
+            //FIFO queue for the slot that frees up first
+            begin = std::max(now, slots_free_at.top());
+            slots_free_at.pop();
+        }
+        int64_t due = begin + int64_t(std::max(0.0, delay_ms) * 1e6);
+        if(options.capacity > 0) slots_free_at.push(due);
+        if(!c.pending.empty()) due = std::max(due, c.pending.back().due_ns);
+        c.pending.push_back({due, std::move(text), close_after});
+        wakeups.push({due, id});
+        if(close_after) c.closing = true;
+    }
+
+    //moves every response whose delay has passed to its connection's output
+    void release_due() {
+        int64_t now = now_ns();
+        while(!wakeups.empty() && wakeups.top().due_ns <= now) {
+            uint64_t id = wakeups.top().conn_id;
+            wakeups.pop();
+            auto it = connections.find(id);
+            if(it == connections.end()) continue;
+            Connection& c = it->second;
+            bool released = false;
+            while(!c.pending.empty() && c.pending.front().due_ns <= now) {
+                c.out += c.pending.front().text;
+                c.pending.pop_front();
+                released = true;
+            }
+            if(released) flush(id);
+        }
+    }
+
+    void flush(uint64_t id) {
+        auto it = connections.find(id);
+        if(it == connections.end()) return;
+        Connection& c = it->second;
+        while(c.out_sent < c.out.size()) {
+            ssize_t sent = send(c.fd, c.out.data() + c.out_sent, c.out.size() - c.out_sent, MSG_NOSIGNAL);
+            if(sent < 0) {
+                if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+                drop(id);
+                return;
+            }
+            c.out_sent += size_t(sent);
+        }
+
+        bool done = c.out_sent == c.out.size();
+        if(done) {
+            c.out.clear();
+            c.out_sent = 0;
+            if(c.closing && c.pending.empty()) {
+                drop(id);
+                return;
+            }
+        }
+        //only ask for EPOLLOUT while there is a backlog
+        if(done == c.writing) {
+            c.writing = !done;
+            epoll_event ev = {};
+            ev.events = EPOLLIN | (c.writing ? uint32_t(EPOLLOUT) : 0u);
+            ev.data.u64 = id;
+            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c.fd, &ev);
+        }
+    }
+};
+
+void usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options]\n"
+              << "  --port N            port to listen on (default 8080)\n"
+              << "  --latency-ms X      delay before each response (default 0)\n"
+              << "  --jitter-ms X       each delay is latency +/- a uniform random jitter (default 0)\n"
+              << "  --error-rate X      fraction of requests answered with 503 (default 0)\n"
+              << "  --capacity N        handle at most N requests at a time, the rest wait (default unlimited)\n"
+              << "  --slow-rate X       fraction of requests delayed by an extra --slow-ms (default 0)\n"
+              << "  --slow-ms X         extra delay of slow requests (default 1000)\n"
+              << "  --graph FILE        serve a tab separated edge list instead of generating a graph\n"
+              << "Graph generator options:\n" << GRAPH_OPTIONS_USAGE;
+}
+
+int main(int argc, char* argv[]) {
+    ServerOptions options;
+    GraphParams params;
+    try {
+        for(int i = 1; i < argc; i++) {
+            std::string flag = argv[i];
+            if(i + 1 >= argc) {
+                usage(argv[0]);
+                return 1;
+            }
+            std::string value = argv[++i];
+            if(flag == "--port") options.port = std::stoi(value);
+            else if(flag == "--latency-ms") options.latency_ms = std::stod(value);
+            else if(flag == "--jitter-ms") options.jitter_ms = std::stod(value);
+            else if(flag == "--error-rate") options.error_rate = std::stod(value);
+            else if(flag == "--capacity") options.capacity = std::stoi(value);
+            else if(flag == "--slow-rate") options.slow_rate = std::stod(value);
+            else if(flag == "--slow-ms") options.slow_ms = std::stod(value);
+            else if(flag == "--graph") options.graph_file = value;
+            else if(!parse_graph_option(flag, value, params)) {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: option values must be numbers.\n";
+        return 1;
+    }
+
+    SyntheticGraph graph;
+    if(!options.graph_file.empty()) {
+        if(!load_edge_list(options.graph_file, graph)) {
+            std::cerr << "Could not read " << options.graph_file << "\n";
+            return 1;
+        }
+    } else {
+        graph = generate_graph(params);
+    }
+    std::cerr << "Serving ";
+    print_graph_summary(std::cerr, graph);
+
+    std::signal(SIGINT, handle_signal);
+    std::signal(SIGTERM, handle_signal);
+
+    MockServer server(graph, options, params.seed);
+    auto start = std::chrono::steady_clock::now();
+    try {
+        server.listen_on(options.port);
+        std::cerr << "Listening on port " << options.port << ", latency " << options.latency_ms << " +/- "
+                  << options.jitter_ms << " ms, error rate " << options.error_rate << std::endl;
+        server.run();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cerr << "Served " << server.requests << " requests in " << elapsed.count() << "s ("
+              << server.requests / elapsed.count() << " req/s), " << server.errors_injected << " injected errors, "
+              << server.slow_injected << " slow responses, "
+              << server.bad_requests << " bad requests\n";
+    return 0;
+}
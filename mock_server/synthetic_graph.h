@@ -0,0 +1,212 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <random>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
+// Synthetic stand-in for the Hollywood graph: a bipartite graph of actors and movies, where each movie
+// links to its cast. Like the real data, both sides have heavy-tailed degrees:
+// - cast sizes follow a discrete power law P(k) ~ k^-cast_exponent on [min_cast, max_cast]
+// - cast members are drawn with weight (rank+1)^-actor_skew, so a few actors appear in many movies.
+//   An actor's number of movies then follows a power law with exponent about 1 + 1/actor_skew
+// Actors the draw never picks are added to one random movie each, so no actor is isolated.
+// The same parameters and seed always produce the same graph. Nodes are named "Actor <i>" and "Movie <j>",
+// and "Actor 0" is the most connected actor, which makes it a good start node
+
+struct GraphParams {
+    uint32_t actors = 100000;
+    uint32_t movies = 25000;
+    uint32_t min_cast = 2;
+    uint32_t max_cast = 80;
+    double cast_exponent = 2.0;
+    double actor_skew = 0.75;
+    uint64_t seed = 1;
+};
+
+// Undirected graph in CSR form: the neighbors of node v are neighbors[offsets[v] .. offsets[v+1])
+class SyntheticGraph {
+    public:
+    std::vector<std::string> names;
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> neighbors;
+    std::unordered_map<std::string, uint32_t> ids;
+
+    size_t num_nodes() const {
+        return names.size();
+    }
+
+    size_t num_edges() const {
+        return neighbors.size() / 2;
+    }
+
+    size_t degree(uint32_t v) const {
+        return offsets[v+1] - offsets[v];
+    }
+
+    //returns nullptr if there is no node with that name
+    const uint32_t* find(const std::string& name) const {
+        auto it = ids.find(name);
+        return it == ids.end() ? nullptr : &it->second;
+    }
+
+    uint32_t add_node(const std::string& name) {
+        auto it = ids.find(name);
+        if(it != ids.end()) return it->second;
+        uint32_t id = uint32_t(names.size());
+        names.push_back(name);
+        ids.emplace(name, id);
+        return id;
+    }
+
+    // Builds the CSR arrays from a list of undirected edges between already added nodes
+    void build(const std::vector<std::pair<uint32_t, uint32_t>>& edges) {
+        offsets.assign(names.size() + 1, 0);
+        for(const auto& e: edges) {
+            offsets[e.first + 1]++;
+            offsets[e.second + 1]++;
+        }
+        for(size_t v = 0; v < names.size(); v++) {
+            offsets[v+1] += offsets[v];
+        }
+        neighbors.resize(offsets.back());
+        std::vector<uint64_t> fill(offsets.begin(), offsets.end() - 1);
+        for(const auto& e: edges) {
+            neighbors[fill[e.first]++] = e.second;
+            neighbors[fill[e.second]++] = e.first;
+        }
+    }
+};
+
+inline SyntheticGraph generate_graph(const GraphParams& params) {
+    if(params.actors == 0 || params.min_cast == 0 || params.min_cast > params.max_cast) {
+        throw std::invalid_argument("need at least one actor and 0 < min_cast <= max_cast");
+    }
+    std::mt19937_64 gen(params.seed);
+
+    std::vector<double> cast_weights;
+    for(uint32_t k = params.min_cast; k <= params.max_cast; k++) {
+        cast_weights.push_back(std::pow(double(k), -params.cast_exponent));
+    }
+    std::discrete_distribution<uint32_t> cast_size(cast_weights.begin(), cast_weights.end());
+
+    std::vector<double> actor_weights(params.actors);
+    for(uint32_t i = 0; i < params.actors; i++) {
+        actor_weights[i] = std::pow(double(i + 1), -params.actor_skew);
+    }
+    std::discrete_distribution<uint32_t> pick_actor(actor_weights.begin(), actor_weights.end());
+
+    SyntheticGraph g;
+    g.names.reserve(size_t(params.actors) + params.movies);
+    for(uint32_t i = 0; i < params.actors; i++) g.add_node("Actor " + std::to_string(i));
+    for(uint32_t j = 0; j < params.movies; j++) g.add_node("Movie " + std::to_string(j));
+
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    std::vector<uint32_t> cast;
+    for(uint32_t j = 0; j < params.movies; j++) {
+        uint32_t size = std::min(params.min_cast + cast_size(gen), params.actors);
+        cast.clear();
+        //draw without repeats. popular actors get redrawn a lot, so give up on a slot after a few tries
+        for(uint32_t slot = 0; slot < size; slot++) {
+            for(int attempt = 0; attempt < 8; attempt++) {
+                uint32_t actor = pick_actor(gen);
+                if(std::find(cast.begin(), cast.end(), actor) == cast.end()) {
+                    cast.push_back(actor);
+                    break;
+                }
+            }
+        }
+        uint32_t movie = params.actors + j;
+        for(uint32_t actor: cast) {
+            edges.emplace_back(movie, actor);
+        }
+    }
+
+    //actors the popularity draw never picked get one movie each, the long tail of one-off credits
+    if(params.movies > 0) {
+        std::vector<bool> cast_at_least_once(params.actors, false);
+        for(const auto& e: edges) cast_at_least_once[e.second] = true;
+        std::uniform_int_distribution<uint32_t> pick_movie(0, params.movies - 1);
+        for(uint32_t i = 0; i < params.actors; i++) {
+            if(!cast_at_least_once[i]) edges.emplace_back(params.actors + pick_movie(gen), i);
+        }
+    }
+    g.build(edges);
+    return g;
+}
+
+// Edge list format: one "name<TAB>name" line per undirected edge. Used to save generated graphs,
+// or to serve a graph from some other source
+inline void write_edge_list(std::ostream& out, const SyntheticGraph& g) {
+    for(uint32_t v = 0; v < g.num_nodes(); v++) {
+        for(uint64_t e = g.offsets[v]; e < g.offsets[v+1]; e++) {
+            //each edge is stored twice, write it once
+            if(v < g.neighbors[e]) {
+                out << g.names[v] << '\t' << g.names[g.neighbors[e]] << '\n';
+            }
+        }
+    }
+}
+
+inline bool load_edge_list(const std::string& path, SyntheticGraph& g) {
+    std::ifstream file(path);
+    if(!file) return false;
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    std::string line;
+    while(std::getline(file, line)) {
+        if(!line.empty() && line.back() == '\r') line.pop_back();
+        size_t tab = line.find('\t');
+        if(tab == std::string::npos) continue;
+        uint32_t a = g.add_node(line.substr(0, tab));
+        uint32_t b = g.add_node(line.substr(tab + 1));
+        edges.emplace_back(a, b);
+    }
+    g.build(edges);
+    return true;
+}
+
+// Parses one "--flag value" generator option. Returns false if flag is not a generator option
+inline bool parse_graph_option(const std::string& flag, const std::string& value, GraphParams& params) {
+    if(flag == "--actors") params.actors = uint32_t(std::stoul(value));
+    else if(flag == "--movies") params.movies = uint32_t(std::stoul(value));
+    else if(flag == "--min-cast") params.min_cast = uint32_t(std::stoul(value));
+    else if(flag == "--max-cast") params.max_cast = uint32_t(std::stoul(value));
+    else if(flag == "--cast-exponent") params.cast_exponent = std::stod(value);
+    else if(flag == "--actor-skew") params.actor_skew = std::stod(value);
+    else if(flag == "--seed") params.seed = std::stoull(value);
+    else return false;
+    return true;
+}
+
+inline const char* GRAPH_OPTIONS_USAGE =
+    "  --actors N          number of actors (default 100000)\n"
+    "  --movies N          number of movies (default 25000)\n"
+    "  --min-cast N        smallest cast size (default 2)\n"
+    "  --max-cast N        largest cast size (default 80)\n"
+    "  --cast-exponent X   power law exponent of cast sizes (default 2.0)\n"
+    "  --actor-skew X      actor popularity skew, larger is more skewed (default 0.75)\n"
+    "  --seed N            random seed (default 1)\n";
+
+inline void print_graph_summary(std::ostream& out, const SyntheticGraph& g) {
+    size_t max_degree = 0;
+    uint32_t max_node = 0;
+    size_t isolated = 0;
+    for(uint32_t v = 0; v < g.num_nodes(); v++) {
+        if(g.degree(v) > max_degree) {
+            max_degree = g.degree(v);
+            max_node = v;
+        }
+        if(g.degree(v) == 0) isolated++;
+    }
+    out << g.num_nodes() << " nodes, " << g.num_edges() << " edges, " << isolated << " isolated";
+    if(g.num_nodes() > 0) {
+        out << ", max degree " << max_degree << " (" << g.names[max_node] << ")";
+    }
+    out << "\n";
+}
@@ -2,102 +2,17 @@
 #include <string>
 #include <queue>
 #include <unordered_set>
-#include <cstdio>
-#include <cstdlib>
+#include <unordered_map>
+#include <functional>
+#include <chrono>
 #include <curl/curl.h>
-#include <stdexcept>
-#include "rapidjson/error/error.h"
-#include "rapidjson/reader.h"
-
-
-struct ParseException : std::runtime_error, rapidjson::ParseResult {
-    ParseException(rapidjson::ParseErrorCode code, const char* msg, size_t offset) : 
-        std::runtime_error(msg), 
-        rapidjson::ParseResult(code, offset) {}
-};
 
-#define RAPIDJSON_PARSE_ERROR_NORETURN(code, offset) \
-    throw ParseException(code, #code, offset)
-
-#include <rapidjson/document.h>
-#include <chrono>
+#include "hollywood_client.h"
+#include "multi_fetcher.h"
 
 
 bool debug = false;
 
-// Updated service URL
-const std::string SERVICE_URL = "http://hollywood-graph-crawler.bridgesuncc.org/neighbors/";
-
-// Function to HTTP ecnode parts of URLs. for instance, replace spaces with '%20' for URLs
-std::string url_encode(CURL* curl, std::string input) {
-  char* out = curl_easy_escape(curl, input.c_str(), input.size());
-  std::string s = out;
-  curl_free(out);
-  return s;
-}
-
-// Callback function for writing response data
-size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* output) {
-    size_t totalSize = size * nmemb;
-    output->append((char*)contents, totalSize);
-    return totalSize;
-}
-
-// Function to fetch neighbors using libcurl with debugging
-std::string fetch_neighbors(CURL* curl, const std::string& node) {
-
-  std::string url = SERVICE_URL + url_encode(curl, node);
-  std::string response;
-
-    if (debug)
-      std::cout << "Sending request to: " << url << std::endl;
-
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    // curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L); // Verbose Logging
-
-    // Set a User-Agent header to avoid potential blocking by the server
-    struct curl_slist* headers = nullptr;
-    headers = curl_slist_append(headers, "User-Agent: C++-Client/1.0");
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-
-    CURLcode res = curl_easy_perform(curl);
-
-    if (res != CURLE_OK) {
-      std::cerr << "CURL error: " << curl_easy_strerror(res) << std::endl;
-    } else {
-      if (debug)
-        std::cout << "CURL request successful!" << std::endl;
-    }
-
-    // Cleanup
-    curl_slist_free_all(headers);
-
-    if (debug) 
-      std::cout << "Response received: " << response << std::endl;  // Debug log
-
-    return (res == CURLE_OK) ? response : "{}";
-}
-
-// Function to parse JSON and extract neighbors
-std::vector<std::string> get_neighbors(const std::string& json_str) {
-    std::vector<std::string> neighbors;
-    try {
-      rapidjson::Document doc;
-      doc.Parse(json_str.c_str());
-      
-      if (doc.HasMember("neighbors") && doc["neighbors"].IsArray()) {
-        for (const auto& neighbor : doc["neighbors"].GetArray())
-	  neighbors.push_back(neighbor.GetString());
-      }
-    } catch (const ParseException& e) {
-      std::cerr<<"Error while parsing JSON: "<<json_str<<std::endl;
-      throw e;
-    }
-    return neighbors;
-}
 
 // BFS Traversal Function
 std::vector<std::vector<std::string>> bfs(CURL* curl, const std::string& start, int depth) {
@@ -133,9 +48,68 @@ std::vector<std::vector<std::string>> bfs(CURL* curl, const std::string& start,
   return levels;
 }
 
+// Pipelined BFS: up to max_in_flight requests run at once through the curl_multi event loop, and every node
+// is fetched as soon as it is discovered instead of after the rest of its level. Each request carries the
+// depth its node was found at, and depth_of keeps the smallest depth seen per node. A response can arrive
+// before one for a shorter path to the same node, so when a node's depth is lowered it is fetched again,
+// and its neighbors are lowered in turn. Responses for a depth that has since been lowered are dropped.
+// Once the event loop drains every depth is the shortest path length, the same levels as bfs()
+std::vector<std::vector<std::string>> pipelined_bfs(MultiFetcher& fetcher, const std::string& start, int depth) {
+  std::unordered_map<std::string, int> depth_of;
+  std::vector<std::string> discovered;
+  std::unordered_set<std::string> expanded;
+  size_t fetches = 0, re_expansions = 0, stale = 0;
+
+  std::function<void(const std::string&, int)> expand = [&](const std::string& s, int d) {
+    fetcher.fetch(s, [&, d](const std::string& node, CURLcode result, long http_code, std::string& body) {
+      fetches++;
+      if (depth_of[node] != d) {
+	stale++;
+	return;
+      }
+      if (!expanded.insert(node).second)
+	re_expansions++;
+      try {
+	for (const auto& neighbor : get_neighbors(MultiFetcher::failed(result, http_code) ? "{}" : body)) {
+	  if (debug)
+	    std::cout<<"neighbor "<<neighbor<<"\n";
+	  auto it = depth_of.find(neighbor);
+	  if (it == depth_of.end()) {
+	    discovered.push_back(neighbor);
+	    depth_of[neighbor] = d+1;
+	  } else if (it->second > d+1) {
+	    it->second = d+1;
+	  } else {
+	    continue;
+	  }
+	  if (d+1 < depth)
+	    expand(neighbor, d+1);
+	}
+      } catch (const ParseException& e) {
+	std::cerr<<"Error while fetching neighbors of: "<<node<<std::endl;
+	throw e;
+      }
+    });
+  };
+
+  discovered.push_back(start);
+  depth_of[start] = 0;
+  if (depth > 0)
+    expand(start, 0);
+  fetcher.run();
+
+  std::cout<<"Pipelined: "<<fetches<<" fetches, "<<re_expansions<<" re-expansions, "<<stale<<" stale responses dropped\n";
+  fetcher.print_stats(std::cout);
+
+  std::vector<std::vector<std::string>> levels(depth + 1);
+  for (const std::string& s : discovered)
+    levels[depth_of[s]].push_back(s);
+  return levels;
+}
+
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " <node_name> <depth>\n";
+    if (argc != 3 && !(argc == 5 && std::string(argv[3]) == "--pipelined")) {
+        std::cerr << "Usage: " << argv[0] << " <node_name> <depth> [--pipelined <max_in_flight>]\n";
         return 1;
     }
 
@@ -147,6 +121,19 @@ int main(int argc, char* argv[]) {
         std::cerr << "Error: Depth must be an integer.\n";
         return 1;
     }
+    int max_in_flight = 0;
+    if (argc == 5) {
+        try {
+            max_in_flight = std::stoi(argv[4]);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Max in flight must be an integer.\n";
+            return 1;
+        }
+        if (max_in_flight <= 0) {
+            std::cerr << "Error: Max in flight must be positive.\n";
+            return 1;
+        }
+    }
 
     CURL* curl = curl_easy_init();
     if (!curl) {
@@ -158,7 +145,14 @@ int main(int argc, char* argv[]) {
     const auto start{std::chrono::steady_clock::now()};
     
     
-    for (const auto& n : bfs(curl, start_node, depth)) {
+    std::vector<std::vector<std::string>> levels;
+    if (max_in_flight > 0) {
+      MultiFetcher fetcher(max_in_flight);
+      levels = pipelined_bfs(fetcher, start_node, depth);
+    } else {
+      levels = bfs(curl, start_node, depth);
+    }
+    for (const auto& n : levels) {
       for (const auto& node : n)
 	std::cout << "- " << node << "\n";
       std::cout<<n.size()<<"\n";
@@ -1,135 +1,70 @@
 #include <iostream>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <deque>
+#include <memory>
+#include <algorithm>
 #include <string>
 #include <queue>
-#include <unordered_set>
-#include <cstdio>
-#include <cstdlib>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+#include <chrono>
+#include <functional>
 #include <curl/curl.h>
-#include <stdexcept>
-#include "rapidjson/error/error.h"
-#include "rapidjson/reader.h"
-
-
-struct ParseException : std::runtime_error, rapidjson::ParseResult {
-    ParseException(rapidjson::ParseErrorCode code, const char* msg, size_t offset) : 
-        std::runtime_error(msg), 
-        rapidjson::ParseResult(code, offset) {}
-};
-
-#define RAPIDJSON_PARSE_ERROR_NORETURN(code, offset) \
-    throw ParseException(code, #code, offset)
 
-#include <rapidjson/document.h>
-#include <chrono>
+#include "hollywood_client.h"
+#include "intern_table.h"
+#include "atomic_bitset.h"
+#include "atomic_depths.h"
+#include "neighbor_cache.h"
+#include "crawl_checkpoint.h"
+#include "spill_frontier.h"
+#include "csr_graph.h"
 
 
 bool debug = true;
 
-// Updated service URL
-const std::string SERVICE_URL = "http://hollywood-graph-crawler.bridgesuncc.org/neighbors/";
-
-// Function to HTTP ecnode parts of URLs. for instance, replace spaces with '%20' for URLs
-std::string url_encode(CURL* curl, std::string input) {
-  char* out = curl_easy_escape(curl, input.c_str(), input.size());
-  std::string s = out;
-  curl_free(out);
-  return s;
-}
-
-// Callback function for writing response data
-size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* output) {
-    size_t totalSize = size * nmemb;
-    output->append((char*)contents, totalSize);
-    return totalSize;
-}
-
-// Function to fetch neighbors using libcurl with debugging
-std::string fetch_neighbors(CURL* curl, const std::string& node) {
-
-  std::string url = SERVICE_URL + url_encode(curl, node);
-  std::string response;
-
-    if (debug)
-      std::cout << "Sending request to: " << url << std::endl;
-
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    // curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L); // Verbose Logging
-
-    // Set a User-Agent header to avoid potential blocking by the server
-    struct curl_slist* headers = nullptr;
-    headers = curl_slist_append(headers, "User-Agent: C++-Client/1.0");
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-
-    CURLcode res = curl_easy_perform(curl);
-
-    if (res != CURLE_OK) {
-      std::cerr << "CURL error: " << curl_easy_strerror(res) << std::endl;
-    } else {
-      if (debug)
-        std::cout << "CURL request successful!" << std::endl;
-    }
-
-    // Cleanup
-    curl_slist_free_all(headers);
-
-    if (debug) 
-      std::cout << "Response received: " << response << std::endl;  // Debug log
-
-    return (res == CURLE_OK) ? response : "{}";
-}
-
-// Function to parse JSON and extract neighbors
-std::vector<std::string> get_neighbors(const std::string& json_str) {
-    std::vector<std::string> neighbors;
-    try {
-      rapidjson::Document doc;
-      doc.Parse(json_str.c_str());
-      
-      if (doc.HasMember("neighbors") && doc["neighbors"].IsArray()) {
-        for (const auto& neighbor : doc["neighbors"].GetArray())
-	        neighbors.push_back(neighbor.GetString());
-      }
-    } catch (const ParseException& e) {
-      std::cerr<<"Error while parsing JSON: "<<json_str<<std::endl;
-      throw e;
-    }
-    return neighbors;
-}
 
 
-void non_blocking_expand_nodes(CURL* curl, std::pair<int, int>& indices, std::vector<std::string>& current_level, std::vector<std::string>& next_level, std::unordered_set<std::string>& visited, std::mutex& mut) {
+//expands current_level[first..last), new nodes go to a buffer owned by this thread
+//nodes are IDs from the intern table, names are only looked up to build the request
+//if parents is given, the node each new node was found from is appended to it alongside
+//if edges is given, every (node, neighbor) pair is appended to it, new neighbor or not
+void non_blocking_expand_nodes(CURL* curl, NeighborCache* cache, ConcurrencyLimiter* limiter, RetryPolicy& retry, size_t first, size_t last, const std::vector<uint32_t>& current_level, std::vector<uint32_t>& next_level_part, std::vector<uint32_t>* parents, EdgeList* edges, InternTable& names, AtomicBitset& visited) {
     auto id = std::this_thread::get_id();
-    for(int i = indices.first; i <= indices.second; i++) {
+    for(size_t i = first; i < last; i++) {
+        std::string node(names.name(current_level[i]));
         try {
             if (debug)
-                std::cout<<"Thread "<< id << " Trying to expand "<<current_level[i]<<"\n";
+                std::cout<<"Thread "<< id << " Trying to expand "<<node<<"\n";
 
-            //for each new neighbor
-            for (const auto& neighbor : get_neighbors(fetch_neighbors(curl, current_level[i]))) {
+            //for each new neighbor, as its name comes off the wire
+            cached_neighbors(curl, cache, limiter, retry, node, [&](std::string_view neighbor) {
                 if (debug)
                     std::cout<<"neighbor "<<neighbor<<"\n";
 
-                std::lock_guard<std::mutex> lg(mut);
-                if (!visited.count(neighbor)) {
-                    visited.insert(neighbor);
-                    next_level.push_back(neighbor);
+                //only the thread that flips the visited bit claims the neighbor, so each node is added once
+                uint32_t neighbor_id = names.intern(neighbor);
+                if (edges)
+                    edges->emplace_back(current_level[i], neighbor_id);
+                if (!visited.test_and_set(neighbor_id)) {
+                    next_level_part.push_back(neighbor_id);
+                    if (parents)
+                        parents->push_back(current_level[i]);
                 }
-
-            }
+            });
         } catch (const ParseException& e) {
-            std::cerr<<"Error while fetching neighbors of: "<<current_level[i]<<std::endl;
-            throw e;
+            std::cerr<<"Error while fetching neighbors of: "<<node<<std::endl;
+            throw;
         }
     }
-    
 }
 
-std::vector<std::pair<int, int>> split_list(const std::vector<std::string>& list, int n_segments) {
+std::vector<std::pair<int, int>> split_list(const std::vector<uint32_t>& list, int n_segments) {
     //returns a vector containing start and end indexes for n sub-lists
 
     std::vector<std::pair<int, int>> result;
@@ -152,46 +87,680 @@ std::vector<std::pair<int, int>> split_list(const std::vector<std::string>& list
     return result;
 }
 
+struct LevelStats {
+    size_t nodes = 0;
+    size_t chunks = 0;
+    double elapsed = 0;     //until the last worker finished
+    double first_idle = 0;  //until the first worker ran out of work
+};
 
+// Worker threads that live for the whole crawl and expand one BFS level at a time.
+// run_level() hands the level to the workers and returns once all of it is expanded. By default workers
+// self-schedule: they take chunks of the level by advancing a shared atomic index, and chunks are guided,
+// a fraction of what is left, so they start large and shrink to single nodes near the end of the level. A
+// worker stuck on a slow or high-degree node then only holds up the nodes of its current chunk, while the
+// others keep taking work. With guided off, worker i expands the fixed slice i of split_list, as the crawler
+// did with one thread per slice
+// Workers publish each node with what it found once the node is fully expanded, so run_level() can report a
+// consistent picture of a level in progress, for checkpoints
+class LevelPool {
+    struct alignas(64) Worker {
+        CURL* curl;
+        std::mutex progress;                //guards found, parents and expanded while the level runs
+        std::vector<uint32_t> found;
+        std::vector<uint32_t> parents;
+        std::vector<size_t> expanded;       //indexes into the level
+        std::vector<uint32_t> pending;      //found by the node being expanded
+        std::vector<uint32_t> pending_parents;
+        EdgeList edges;
+        size_t chunks = 0;
+        double finished = 0;
+        std::exception_ptr error;
+    };
+
+    NeighborCache* cache;
+    ConcurrencyLimiter* limiter;
+    RetryPolicy& retry;
+    bool guided;
+    std::vector<Worker> workers;
+    std::vector<std::thread> threads;
 
-// BFS Traversal Function
-std::vector<std::vector<std::string>> bfs(std::vector<CURL*>& curl_handles, const std::string& start, int depth) {
-    std::vector<std::vector<std::string>> levels;
-    std::unordered_set<std::string> visited;
-    int max_threads = curl_handles.size();
-    std::vector<std::thread> threadgroup;
     std::mutex mut;
-    
-    levels.push_back({start});
-    visited.insert(start);
+    std::condition_variable level_ready;
+    std::condition_variable level_finished;
+    uint64_t generation = 0;
+    int busy = 0;
+    bool stopping = false;
+
+    //the level being expanded, only changed while no worker is busy
+    const std::vector<uint32_t>* current = nullptr;
+    InternTable* names = nullptr;
+    AtomicBitset* visited = nullptr;
+    bool record_parents = false;
+    EdgeList* edges = nullptr;
+    std::vector<std::pair<int, int>> slices;
+    std::chrono::steady_clock::time_point level_start;
+    std::atomic<size_t> next_index{0};
+
+    // Claims the next chunk of the current level for worker w. Returns false once the level is handed out
+    bool claim(int w, size_t& first, size_t& last) {
+        size_t n = current->size();
+        if (!guided) {
+            //static: one fixed slice per worker
+            if (workers[w].chunks > 0 || w >= int(slices.size())) return false;
+            first = slices[w].first;
+            last = slices[w].second + 1;
+            return true;
+        }
+
+        size_t i = next_index.load(std::memory_order_relaxed);
+        while (i < n) {
+            size_t chunk = std::max<size_t>(1, (n - i) / (2 * workers.size()));
+            if (next_index.compare_exchange_weak(i, i + chunk, std::memory_order_relaxed)) {
+                first = i;
+                last = i + chunk;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void work(int w) {
+        Worker& self = workers[w];
+        uint64_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lg(mut);
+                level_ready.wait(lg, [&]{ return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+            }
+
+            size_t first, last;
+            try {
+                while (claim(w, first, last)) {
+                    self.chunks++;
+                    for (size_t i = first; i < last; i++) {
+                        non_blocking_expand_nodes(self.curl, cache, limiter, retry, i, i + 1, *current, self.pending, record_parents ? &self.pending_parents : nullptr, edges ? &self.edges : nullptr, *names, *visited);
+                        std::lock_guard<std::mutex> lg(self.progress);
+                        self.found.insert(self.found.end(), self.pending.begin(), self.pending.end());
+                        self.parents.insert(self.parents.end(), self.pending_parents.begin(), self.pending_parents.end());
+                        self.expanded.push_back(i);
+                        self.pending.clear();
+                        self.pending_parents.clear();
+                    }
+                }
+            } catch (...) {
+                //handed to the main thread, the remaining workers still finish the level
+                self.error = std::current_exception();
+            }
+            const std::chrono::duration<double> t{std::chrono::steady_clock::now() - level_start};
+            self.finished = t.count();
+
+            std::unique_lock<std::mutex> lg(mut);
+            if (--busy == 0)
+                level_finished.notify_one();
+        }
+    }
+
+    // Hands on_progress the nodes expanded so far and what they found
+    void report_progress(const std::function<void(const std::vector<size_t>&, const std::vector<uint32_t>&)>& on_progress) {
+        std::vector<size_t> expanded;
+        std::vector<uint32_t> found;
+        for (Worker& worker: workers) {
+            std::lock_guard<std::mutex> lg(worker.progress);
+            expanded.insert(expanded.end(), worker.expanded.begin(), worker.expanded.end());
+            found.insert(found.end(), worker.found.begin(), worker.found.end());
+        }
+        on_progress(expanded, found);
+    }
+
+    public:
+
+    // Called with the indexes of the level's nodes that are expanded and the new nodes they found
+    typedef std::function<void(const std::vector<size_t>& expanded, const std::vector<uint32_t>& found)> ProgressCallback;
+
+    // One worker per curl handle
+    LevelPool(std::vector<CURL*>& curl_handles, NeighborCache* cache, ConcurrencyLimiter* limiter, RetryPolicy& retry, bool guided)
+        : cache(cache), limiter(limiter), retry(retry), guided(guided), workers(curl_handles.size()) {
+        for (int i = 0; i < curl_handles.size(); i++) {
+            workers[i].curl = curl_handles[i];
+        }
+        for (int i = 0; i < curl_handles.size(); i++) {
+            threads.push_back(std::thread(&LevelPool::work, this, i));
+        }
+    }
+
+    ~LevelPool() {
+        {
+            std::unique_lock<std::mutex> lg(mut);
+            stopping = true;
+        }
+        level_ready.notify_all();
+        for (auto& t: threads) {
+            t.join();
+        }
+    }
+
+    LevelPool(const LevelPool&) = delete;
+    LevelPool& operator=(const LevelPool&) = delete;
+
+    // From here on, every edge expanded levels have is appended to edges at the end of the level
+    void keep_edges(EdgeList* edges) {
+        this->edges = edges;
+    }
+
+    // Expands every node of level, interning neighbors in names, the table level's IDs are from, marking them in
+    // visited and appending the newly visited ones to next_level. If next_parents is given, the node each one was found from is appended to it alongside.
+    // If on_progress is given, it is called every interval seconds while the level runs, and once more before a
+    // failed level throws
+    LevelStats run_level(const std::vector<uint32_t>& level, InternTable& names, AtomicBitset& visited, std::vector<uint32_t>& next_level, std::vector<uint32_t>* next_parents = nullptr,
+                         const ProgressCallback& on_progress = nullptr, double interval = 0) {
+        std::unique_lock<std::mutex> lg(mut);
+        current = &level;
+        this->names = &names;
+        this->visited = &visited;
+        record_parents = next_parents != nullptr;
+        if (!guided)
+            slices = split_list(level, workers.size());
+        next_index.store(0, std::memory_order_relaxed);
+        for (Worker& worker: workers) {
+            worker.chunks = 0;
+            worker.expanded.clear();
+            worker.pending.clear();
+            worker.pending_parents.clear();
+        }
+        level_start = std::chrono::steady_clock::now();
+        busy = workers.size();
+        generation++;
+        level_ready.notify_all();
+
+        //level barrier. workers only take mut once they run out of work, so progress is reported without it
+        auto done = [this]{ return busy == 0; };
+        if (on_progress) {
+            while (!level_finished.wait_for(lg, std::chrono::duration<double>(interval), done)) {
+                lg.unlock();
+                report_progress(on_progress);
+                lg.lock();
+            }
+        } else {
+            level_finished.wait(lg, done);
+        }
+
+        //what the level got done before it failed is kept, the worker that failed published nothing of its node
+        for (Worker& worker: workers) {
+            if (worker.error && on_progress) {
+                report_progress(on_progress);
+                break;
+            }
+        }
+
+        LevelStats stats;
+        stats.nodes = level.size();
+        stats.first_idle = workers.empty() ? 0 : workers[0].finished;
+        for (Worker& worker: workers) {
+            if (worker.error)
+                std::rethrow_exception(worker.error);
+            next_level.insert(next_level.end(), worker.found.begin(), worker.found.end());
+            worker.found.clear();
+            if (next_parents)
+                next_parents->insert(next_parents->end(), worker.parents.begin(), worker.parents.end());
+            worker.parents.clear();
+            if (edges)
+                edges->insert(edges->end(), worker.edges.begin(), worker.edges.end());
+            worker.edges.clear();
+            stats.chunks += worker.chunks;
+            stats.elapsed = std::max(stats.elapsed, worker.finished);
+            stats.first_idle = std::min(stats.first_idle, worker.finished);
+        }
+        return stats;
+    }
+};
+
+
+
+// BFS Traversal Function
+// guided picks the pool's scheduling, see LevelPool
+// With a checkpoint file, progress is saved after every level and every checkpoint interval within one, and
+// with resume the crawl continues from the file: saved levels are kept, and of the level that was running only
+// the nodes that were not expanded yet are fetched
+// If edges is given, the edges of every expanded node are appended to it
+std::vector<std::vector<uint32_t>> bfs(std::vector<CURL*>& curl_handles, NeighborCache* cache, ConcurrencyLimiter* limiter, RetryPolicy& retry, InternTable& names, const std::string& start, int depth, bool guided,
+                                       const CheckpointOptions& checkpoint, EdgeList* edges = nullptr) {
+    std::vector<std::vector<uint32_t>> levels;
+    AtomicBitset visited;
+    LevelPool pool(curl_handles, cache, limiter, retry, guided);
+    pool.keep_edges(edges);
+    std::vector<std::pair<int, LevelStats>> stats;
+
+    uint32_t start_id = names.intern(start);
+    levels.push_back({start_id});
+    //of the last level: how many of its nodes are expanded, and what they found
+    size_t expanded = 0;
+    std::vector<uint32_t> found;
+
+    std::unique_ptr<CheckpointFile> file;
+    if (!checkpoint.path.empty()) {
+        file.reset(new CheckpointFile(checkpoint.path));
+        if (checkpoint.resume && file->exists()) {
+            CrawlProgress saved = file->load(names);
+            if (saved.start != start)
+                throw std::invalid_argument("checkpoint " + checkpoint.path + " is a crawl from " + saved.start);
+            levels = std::move(saved.levels);
+            levels.push_back(std::move(saved.frontier));
+            expanded = saved.expanded;
+            found = std::move(saved.found);
+            std::cout << "Resuming from " << checkpoint.path << ": " << levels.size() - 1 << " levels done, "
+                      << expanded << " of " << levels.back().size() << " nodes of the next expanded\n";
+            if (levels.size() > depth + 1) {
+                levels.resize(depth + 1);
+                found.clear();
+            }
+        }
+    }
+    //in a level by level crawl, the visited nodes are exactly the ones in the lists
+    for (const auto& level : levels) {
+        for (uint32_t node : level)
+            visited.test_and_set(node);
+    }
+    for (uint32_t node : found)
+        visited.test_and_set(node);
+
+    for (int d = levels.size() - 1;  d < depth; d++) {
+        if (debug)
+            std::cout<<"starting level: "<<d<<"\n";
+
+        std::vector<uint32_t> todo(levels[d].begin() + expanded, levels[d].end());
+        std::vector<uint32_t> next = std::move(found);
+        found.clear();
+
+        //saves the level with its expanded nodes moved to the front
+        LevelPool::ProgressCallback save_progress;
+        if (file) {
+            save_progress = [&](const std::vector<size_t>& done, const std::vector<uint32_t>& part) {
+                std::vector<uint32_t> frontier(levels[d].begin(), levels[d].begin() + expanded);
+                std::vector<bool> is_done(todo.size());
+                for (size_t i : done) {
+                    frontier.push_back(todo[i]);
+                    is_done[i] = true;
+                }
+                for (size_t i = 0; i < todo.size(); i++) {
+                    if (!is_done[i])
+                        frontier.push_back(todo[i]);
+                }
+                std::vector<uint32_t> next_part = next;
+                next_part.insert(next_part.end(), part.begin(), part.end());
+                file->save(names, start, levels, d, frontier, expanded + done.size(), next_part);
+            };
+        }
+        stats.emplace_back(d, pool.run_level(todo, names, visited, next, nullptr, save_progress, checkpoint.interval));
+        levels.push_back(std::move(next));
+        expanded = 0;
+        if (file)
+            file->save(names, start, levels, d + 1, levels[d + 1], 0, {});
+    }
+
+    //straggler time: how long the level barrier kept the first idle worker waiting for the last one
+    for (const auto& [d, s] : stats) {
+        std::cout << "Level " << d << ": " << s.nodes << " nodes in " << s.chunks << " chunks, " << s.elapsed
+                  << "s, straggler time " << s.elapsed - s.first_idle << "s\n";
+    }
+
+    return levels;
+}
+
+// Level by level crawl within a memory budget, with the levels on disk, see spill_frontier.h. Each level is read
+// back in batches, and every batch is expanded on the crawl's LevelPool with an intern table and visited bits of
+// its own, which only dedupe within the batch, so nothing in memory grows with the crawl. The batch size follows how many
+// new names the last batch found per byte of it, so high-degree levels take smaller batches
+std::unique_ptr<SpilledLevels> spilling_bfs(std::vector<CURL*>& curl_handles, NeighborCache* cache, ConcurrencyLimiter* limiter, RetryPolicy& retry, const std::string& start, int depth, bool guided,
+                                            const SpillOptions& spill) {
+    std::unique_ptr<SpilledLevels> levels(new SpilledLevels(spill));
+    levels->start(start);
+    size_t batch_bytes = levels->batch_bytes();
+    //a small budget splits a level into many batches, which share the pool's threads
+    LevelPool pool(curl_handles, cache, limiter, retry, guided);
 
     for (int d = 0;  d < depth; d++) {
         if (debug)
             std::cout<<"starting level: "<<d<<"\n";
-        
-        levels.push_back({});
 
+        NameRuns found(levels->run_prefix(), levels->run_bytes());
+        size_t batches = 0;
+        levels->level(d).for_each_batch(batch_bytes, [&](const std::vector<std::string>& batch) {
+            InternTable names;
+            AtomicBitset seen;
+            std::vector<uint32_t> ids, next;
+            size_t bytes = 0;
+            for (const std::string& name : batch) {
+                uint32_t id = names.intern(name);
+                seen.test_and_set(id);
+                ids.push_back(id);
+                bytes += name.size();
+            }
+            pool.run_level(ids, names, seen, next);
+
+            size_t found_bytes = 0;
+            for (uint32_t id : next) {
+                found.add(names.name(id));
+                found_bytes += names.name(id).size();
+            }
+            batches++;
+            //a batch and what it finds are both held in memory, found names costing their intern table entry too
+            double growth = 1 + 2.0 * found_bytes / std::max<size_t>(1, bytes);
+            batch_bytes = std::max<size_t>(1, levels->batch_bytes() / growth);
+        });
+        levels->add_level(found);
+        std::cout << "Level " << d << ": " << levels->level(d).size() << " nodes in " << batches << " batches, "
+                  << found.spilled() << " runs\n";
+    }
+    return levels;
+}
+
+// One end of a bidirectional search
+struct SearchSide {
+    const char* name;
+    AtomicBitset visited;
+    //every node reached from this end, with the node it was reached from and its distance to this end
+    std::unordered_map<uint32_t, std::pair<uint32_t, int>> reached;
+    std::vector<uint32_t> frontier;
+    int distance = 0;
+
+    SearchSide(const char* name, uint32_t id) : name(name) {
+        visited.test_and_set(id);
+        reached[id] = {id, 0};
+        frontier.push_back(id);
+    }
 
-        std::vector<std::pair<int, int>> indices = split_list(levels[d], max_threads);
-        for(int i = 0; i < indices.size(); i++) {
-            threadgroup.push_back(std::thread(non_blocking_expand_nodes, curl_handles[i], std::ref(indices[i]), std::ref(levels[d]), std::ref(levels[d+1]), std::ref(visited), std::ref(mut)));
+    // Nodes from id back to this end, id first
+    std::vector<uint32_t> path_from(uint32_t id) const {
+        std::vector<uint32_t> path = {id};
+        while (reached.at(id).second > 0) {
+            id = reached.at(id).first;
+            path.push_back(id);
         }
+        return path;
+    }
+};
 
-        //recover all threads
-        for(auto& t: threadgroup) {
-            t.join();
+// Shortest path query: a BFS from each end, at most max_length steps between them in total, counting the HTTP
+// requests made in requests (cache hits are free, retries and hedges count). Returns the path from start to
+// target, or nothing if there is none that short.
+// The graph is undirected (a movie lists its actors and an actor their movies), so the neighbors of a node
+// are also the nodes one step closer to it and the search from target can use the same requests.
+// Each round expands one whole frontier in parallel on the pool, always the smaller one, since the cost of a
+// round is a request per frontier node. A ball of radius d/2 around each end is usually far smaller than the
+// ball of radius d around one of them, so a query needs a fraction of the requests of a full crawl.
+// The search stops after the round where the frontiers first meet. Every node found in that round is one step
+// further from the expanded end, so the shortest path goes through the one closest to the other end
+std::vector<uint32_t> shortest_path(std::vector<CURL*>& curl_handles, NeighborCache* cache, ConcurrencyLimiter* limiter, RetryPolicy& retry, InternTable& names, const std::string& start, const std::string& target, int max_length, bool guided, size_t& requests) {
+    uint32_t start_id = names.intern(start);
+    uint32_t target_id = names.intern(target);
+    if (start_id == target_id)
+        return {start_id};
+
+    LevelPool pool(curl_handles, cache, limiter, retry, guided);
+    SearchSide from_start("start", start_id);
+    SearchSide from_target("target", target_id);
+    requests = 0;
+
+    while (from_start.distance + from_target.distance < max_length && !from_start.frontier.empty() && !from_target.frontier.empty()) {
+        bool start_smaller = from_start.frontier.size() <= from_target.frontier.size();
+        SearchSide& side = start_smaller ? from_start : from_target;
+        SearchSide& other = start_smaller ? from_target : from_start;
+
+        std::vector<uint32_t> next, parents;
+        uint64_t attempts = retry.attempts_made();
+        LevelStats s = pool.run_level(side.frontier, names, side.visited, next, &parents);
+        requests += retry.attempts_made() - attempts;
+        side.distance++;
+        std::cout << "Expanded " << s.nodes << " nodes at distance " << side.distance - 1 << " from " << side.name
+                  << " in " << s.chunks << " chunks, " << s.elapsed << "s, found " << next.size() << "\n";
+
+        uint32_t meeting = 0;
+        int best = -1;
+        for (size_t i = 0; i < next.size(); i++) {
+            side.reached[next[i]] = {parents[i], side.distance};
+            auto it = other.reached.find(next[i]);
+            if (it != other.reached.end() && (best < 0 || it->second.second < best)) {
+                meeting = next[i];
+                best = it->second.second;
+            }
+        }
+        side.frontier = std::move(next);
+
+        if (best >= 0 && side.distance + best <= max_length) {
+            std::vector<uint32_t> path = from_start.path_from(meeting);
+            std::reverse(path.begin(), path.end());
+            std::vector<uint32_t> rest = from_target.path_from(meeting);
+            path.insert(path.end(), rest.begin() + 1, rest.end());
+            return path;
+        }
+    }
+    return {};
+}
+
+// A node to expand, with the depth it was reached at
+struct Task {
+    uint32_t id;
+    int depth;
+};
+
+// Work queue for the pipelined crawl: one FIFO per depth, shallowest tasks first, and no level barrier.
+// Workers call pop() for a task and done() once they have pushed the tasks it produced. When nothing is
+// queued or in progress, no more work can appear and pop() returns false in every worker. abort() does the
+// same right away, for a worker that failed
+class DepthQueue {
+    std::vector<std::deque<Task>> by_depth;
+    size_t queued = 0;
+    size_t in_progress = 0;
+    bool complete = false;
+    std::mutex mut;
+    std::condition_variable not_empty;
+
+    public:
+
+    DepthQueue(int max_depth) : by_depth(max_depth + 1) {
+    }
+
+    void push(const Task& task) {
+        std::unique_lock<std::mutex> lg(mut);
+        //after an abort, tasks still being expanded may push more
+        if (complete) return;
+        by_depth[task.depth].push_back(task);
+        queued++;
+        not_empty.notify_one();
+    }
+
+    // Returns false once all work is finished
+    bool pop(Task& task) {
+        std::unique_lock<std::mutex> lg(mut);
+        not_empty.wait(lg, [this]{ return queued > 0 || complete; });
+        if (queued == 0) return false;
+
+        for (auto& tasks: by_depth) {
+            if (tasks.empty()) continue;
+            task = tasks.front();
+            tasks.pop_front();
+            break;
         }
-        threadgroup.clear();
+        queued--;
+        in_progress++;
+        return true;
+    }
 
+    void done() {
+        std::unique_lock<std::mutex> lg(mut);
+        in_progress--;
+        if (queued == 0 && in_progress == 0) {
+            complete = true;
+            not_empty.notify_all();
+        }
+    }
 
+    // Drops all queued tasks, so every pop() returns false from now on
+    void abort() {
+        std::unique_lock<std::mutex> lg(mut);
+        for (auto& tasks: by_depth) {
+            tasks.clear();
+        }
+        queued = 0;
+        complete = true;
+        not_empty.notify_all();
+    }
+};
+
+struct PipelineStats {
+    size_t fetches = 0;
+    size_t re_expansions = 0;   //nodes fetched again after a shorter path to them was found
+    size_t stale = 0;           //tasks dropped because a shorter path was found while they were queued
+};
+
+// A failed task stops the whole crawl: its exception goes to error and the queue is aborted
+void pipelined_expand_nodes(CURL* curl, NeighborCache* cache, ConcurrencyLimiter* limiter, RetryPolicy& retry, DepthQueue& q, InternTable& names, AtomicDepths& depths, AtomicBitset& expanded, int max_depth, PipelineStats& stats, std::exception_ptr& error) {
+    auto id = std::this_thread::get_id();
+    Task task{0, 0};
+    while (q.pop(task)) {
+        if (depths.get(task.id) != task.depth) {
+            stats.stale++;
+            q.done();
+            continue;
+        }
+        if (expanded.test_and_set(task.id))
+            stats.re_expansions++;
+        stats.fetches++;
+
+        std::string node(names.name(task.id));
+        try {
+            if (debug)
+                std::cout<<"Thread "<< id << " Trying to expand "<<node<<" at depth "<<task.depth<<"\n";
+
+            cached_neighbors(curl, cache, limiter, retry, node, [&](std::string_view neighbor) {
+                //only the thread that lowers the neighbor's depth queues it, so it is expanded again only
+                //when a shorter path to it turns up
+                uint32_t neighbor_id = names.intern(neighbor);
+                if (depths.relax(neighbor_id, task.depth + 1) && task.depth + 1 < max_depth) {
+                    q.push(Task{neighbor_id, task.depth + 1});
+                }
+            });
+        } catch (...) {
+            std::cerr<<"Error while fetching neighbors of: "<<node<<std::endl;
+            //handed to the main thread, which rethrows it once every worker has stopped
+            error = std::current_exception();
+            q.abort();
+            q.done();
+            return;
+        }
+        q.done();
+    }
+}
+
+// Pipelined BFS: nodes are expanded as soon as they are discovered instead of one level at a time, so a
+// slow request only holds up the nodes behind it rather than the whole next level.
+// Every task carries the depth it was found at and each node keeps the smallest depth seen so far. Threads
+// can reach a node over a longer path first; when a shorter one turns up the node's depth is lowered and it
+// is expanded again, so its neighbors get lowered too. Once the queue drains every depth is the shortest
+// path length, and the levels are the same as the level-synchronous bfs()
+std::vector<std::vector<uint32_t>> pipelined_bfs(std::vector<CURL*>& curl_handles, NeighborCache* cache, ConcurrencyLimiter* limiter, RetryPolicy& retry, InternTable& names, const std::string& start, int depth) {
+    if (depth >= AtomicDepths::UNREACHED)
+        throw std::invalid_argument("Depth is too large for the pipelined crawl");
+
+    AtomicDepths depths;
+    AtomicBitset expanded;
+    DepthQueue q(depth);
+    std::vector<PipelineStats> stats(curl_handles.size());
+    std::vector<std::exception_ptr> errors(curl_handles.size());
+    std::vector<std::thread> threadgroup;
+
+    uint32_t start_id = names.intern(start);
+    depths.relax(start_id, 0);
+    if (depth > 0)
+        q.push(Task{start_id, 0});
+
+    for (int i = 0; i < curl_handles.size(); i++) {
+        threadgroup.push_back(std::thread(pipelined_expand_nodes, curl_handles[i], cache, limiter, std::ref(retry), std::ref(q), std::ref(names), std::ref(depths), std::ref(expanded), depth, std::ref(stats[i]), std::ref(errors[i])));
+    }
+    for (auto& t: threadgroup) {
+        t.join();
+    }
+    for (const std::exception_ptr& error: errors) {
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    PipelineStats total;
+    for (const PipelineStats& s: stats) {
+        total.fetches += s.fetches;
+        total.re_expansions += s.re_expansions;
+        total.stale += s.stale;
+    }
+    std::cout << "Pipelined: " << total.fetches << " fetches, " << total.re_expansions << " re-expansions, "
+              << total.stale << " stale tasks skipped\n";
+
+    //IDs are handed out in discovery order, so each level lists its nodes in the order they were first found
+    std::vector<std::vector<uint32_t>> levels(depth + 1);
+    for (uint32_t node = 0; node < names.size(); node++) {
+        levels[depths.get(node)].push_back(node);
     }
-    
     return levels;
 }
 
+void usage(const char* program) {
+    std::cerr << "Usage: " << program << " <node_name> <depth> <max_threads> [--static | --pipelined] [--path-to NODE] [--export-csr FILE] [cache options] [limiter options] [retry options] [checkpoint options] [spill options]\n"
+              << "  --path-to NODE       print a shortest path from node_name to NODE of at most depth steps, instead of crawling\n"
+              << "  --export-csr FILE    also write the crawled graph to FILE in the binary format of csr_graph.h\n"
+              << CACHE_OPTIONS_USAGE
+              << LIMITER_OPTIONS_USAGE
+              << RETRY_OPTIONS_USAGE
+              << CHECKPOINT_OPTIONS_USAGE
+              << SPILL_OPTIONS_USAGE;
+}
+
 int main(int argc, char* argv[]) {
-    if (argc != 4) {
-        std::cerr << "Usage: " << argv[0] << " <node_name> <depth> <max_threads>\n";
+    if (argc < 4) {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string mode;
+    std::string path_to;
+    std::string export_csr;
+    CacheOptions cache_options;
+    LimiterOptions limiter_options;
+    RetryOptions retry_options;
+    CheckpointOptions checkpoint_options;
+    SpillOptions spill_options;
+    try {
+        for (int i = 4; i < argc; i++) {
+            std::string arg = argv[i];
+            if ((arg == "--static" || arg == "--pipelined") && mode.empty())
+                mode = arg;
+            else if (arg == "--path-to" && i + 1 < argc)
+                path_to = argv[++i];
+            else if (arg == "--export-csr" && i + 1 < argc)
+                export_csr = argv[++i];
+            else if (!parse_cache_option(argc, argv, i, cache_options) && !parse_limiter_option(argc, argv, i, limiter_options)
+                     && !parse_retry_option(argc, argv, i, retry_options)
+                     && !parse_checkpoint_option(argc, argv, i, checkpoint_options) && !parse_spill_option(argc, argv, i, spill_options))
+                throw std::invalid_argument("unknown option " + arg);
+        }
+        if (cache_options.cache_only && cache_options.path.empty())
+            throw std::invalid_argument("--cache-only needs --cache");
+        if (cache_options.ttl_seconds >= 0 && cache_options.path.empty())
+            throw std::invalid_argument("--cache-ttl needs --cache");
+        if (!path_to.empty() && mode == "--pipelined")
+            throw std::invalid_argument("--path-to runs level by level and cannot be --pipelined");
+        if (checkpoint_options.resume && checkpoint_options.path.empty())
+            throw std::invalid_argument("--resume needs --checkpoint");
+        if (!checkpoint_options.path.empty() && (mode == "--pipelined" || !path_to.empty()))
+            throw std::invalid_argument("only level by level crawls can be checkpointed, not --pipelined or --path-to");
+        if (spill_options.budget_bytes > 0 && (mode == "--pipelined" || !path_to.empty() || !checkpoint_options.path.empty()))
+            throw std::invalid_argument("--memory-budget cannot be combined with --pipelined, --path-to or --checkpoint");
+        //a resumed crawl never sees the edges of nodes expanded before the checkpoint
+        if (!export_csr.empty() && (mode == "--pipelined" || !path_to.empty() || spill_options.budget_bytes > 0 || checkpoint_options.resume))
+            throw std::invalid_argument("--export-csr needs a level by level crawl in memory, without --resume");
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        usage(argv[0]);
         return 1;
     }
 
@@ -203,6 +772,10 @@ int main(int argc, char* argv[]) {
         std::cerr << "Error: Depth must be an integer.\n";
         return 1;
     }
+    if (depth < 0) {
+        std::cerr << "Error: Depth must not be negative.\n";
+        return 1;
+    }
     int max_threads;
     try {
         max_threads = std::stoi(argv[3]);
@@ -210,6 +783,10 @@ int main(int argc, char* argv[]) {
         std::cerr << "Error: Max threads must be an integer.\n";
         return 1;
     }
+    if (max_threads <= 0) {
+        std::cerr << "Error: Max threads must be positive.\n";
+        return 1;
+    }
 
     //create a curl handle for each thread
     std::vector<CURL*> curl_handles;
@@ -228,15 +805,102 @@ int main(int argc, char* argv[]) {
     const auto start{std::chrono::steady_clock::now()};
     
     
-    for (const auto& n : bfs(curl_handles, start_node, depth)) {
-        for (const auto& node : n)
-	        std::cout << "- " << node << "\n";
+    //opening the cache indexes it, which counts as part of the crawl
+    std::unique_ptr<NeighborCache> cache;
+    try {
+        if (!cache_options.path.empty())
+            cache.reset(new NeighborCache(cache_options));
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    std::unique_ptr<ConcurrencyLimiter> limiter;
+    if (limiter_options.adaptive || limiter_options.max_rate > 0)
+        limiter.reset(new ConcurrencyLimiter(limiter_options, max_threads));
+    RetryPolicy retry(retry_options);
+
+    InternTable names;
+    std::vector<std::vector<uint32_t>> levels;
+    EdgeList edges;
+    if (!path_to.empty()) {
+        size_t requests = 0;
+        std::vector<uint32_t> path;
+        try {
+            path = shortest_path(curl_handles, cache.get(), limiter.get(), retry, names, start_node, path_to, depth, mode != "--static", requests);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+        if (path.empty())
+            std::cout << "No path of at most " << depth << " steps from " << start_node << " to " << path_to << "\n";
+        else
+            std::cout << "Path of " << path.size() - 1 << " steps from " << start_node << " to " << path_to << "\n";
+        for (uint32_t node : path)
+            std::cout << "- " << names.name(node) << "\n";
+        std::cout << "Requests: " << requests << "\n";
+    } else if (spill_options.budget_bytes > 0) {
+        //levels are printed from disk as they are streamed back, in sorted order
+        try {
+            std::unique_ptr<SpilledLevels> spilled = spilling_bfs(curl_handles, cache.get(), limiter.get(), retry, start_node, depth, mode != "--static", spill_options);
+            size_t batch_bytes = spilled->batch_bytes();
+            for (size_t d = 0; d < spilled->size(); d++) {
+                spilled->level(d).for_each_batch(batch_bytes, [](const std::vector<std::string>& batch) {
+                    for (const std::string& node : batch)
+                        std::cout << "- " << node << "\n";
+                });
+                std::cout << spilled->level(d).size() << "\n";
+            }
+            spilled->print_stats(std::cout);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+    } else if (mode == "--pipelined") {
+        try {
+            levels = pipelined_bfs(curl_handles, cache.get(), limiter.get(), retry, names, start_node, depth);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+    } else {
+        //a crawl that fails with a checkpoint can be resumed, so it exits like any other error
+        try {
+            levels = bfs(curl_handles, cache.get(), limiter.get(), retry, names, start_node, depth, mode != "--static", checkpoint_options, export_csr.empty() ? nullptr : &edges);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+    }
+    for (const auto& n : levels) {
+        for (uint32_t node : n)
+	        std::cout << "- " << names.name(node) << "\n";
         std::cout<<n.size()<<"\n";
     }
     
     const auto finish{std::chrono::steady_clock::now()};
     const std::chrono::duration<double> elapsed_seconds{finish - start};
     std::cout << "Time to crawl: "<<elapsed_seconds.count() << "s\n";
+
+    if (!export_csr.empty()) {
+        std::vector<uint32_t> nodes;
+        for (const auto& level : levels)
+            nodes.insert(nodes.end(), level.begin(), level.end());
+        try {
+            write_csr_graph(export_csr, names, nodes, edges);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+        const std::chrono::duration<double> export_seconds{std::chrono::steady_clock::now() - finish};
+        std::cout << "Exported " << nodes.size() << " nodes and " << edges.size() << " fetched edges to " << export_csr
+                  << " in " << export_seconds.count() << "s\n";
+    }
+    if (cache)
+        cache->print_stats(std::cout);
+    if (limiter)
+        limiter->print_stats(std::cout);
+    retry.print_stats(std::cout);
     
     //cleanup all the handles
     for(CURL* curl: curl_handles) {
@@ -7,10 +7,15 @@
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <unordered_map>
+#include <unordered_set>
 #include <stdexcept>
 #include <chrono>
+#include <cstdint>
 
-const std::string ENDPOINT = "http://hollywood-graph-crawler.bridgesuncc.org/neighbors/";
+#include "../crawler_common/service_url.h"
+
+const std::string ENDPOINT = service_url();
 
 // void replace_spaces(std::string& s, std::string replacement) {
 //     for(size_t i = 0; i < s.length(); ++i) {
@@ -106,76 +111,139 @@ std::vector<std::string> parse_neighbors(std::string const &json_string) {
     return neighbors;
 }
 
-class Node {
-    public:
-    std::string value;
-    Node* parent;
-    std::vector<Node> children;
-    int depth;
+// Fetches and parses each distinct node once per run, however many times it shows up in the tree.
+// Names are interned to IDs, so neighbor lists and tree nodes hold 4-byte IDs instead of strings
+class NeighborMemo {
     CURL* curl;
+    std::unordered_map<std::string, uint32_t> ids;
+    std::vector<std::string> names;
+    std::vector<std::vector<uint32_t>> neighbors;
+    std::vector<bool> fetched;
+
+    public:
+    size_t fetches = 0;
+    size_t repeats = 0;
 
-    Node(std::string value, int depth, CURL* curl_pointer) {
-        this->value = value;
-        this->depth = depth;
-        this->curl = curl_pointer;
-        parent = NULL;
+    NeighborMemo(CURL* curl_pointer) {
+        curl = curl_pointer;
     }
 
-    bool value_exists(const std::string& v) {
-        if(depth == 0 && value != v) {
-            return false;
-        }
+    uint32_t intern(const std::string& name) {
+        auto it = ids.find(name);
+        if(it != ids.end()) return it->second;
 
-        return (value == v) || parent->value_exists(v);
+        uint32_t id = names.size();
+        ids.emplace(name, id);
+        names.push_back(name);
+        neighbors.emplace_back();
+        fetched.push_back(false);
+        return id;
     }
 
-    void create_child(std::string val) {
-        //std::cout<<"Node "<<value<<" creating child "<<val<<", depth = "<<(this->depth+1)<<"\n";
-        Node child = Node(val, this->depth + 1, this->curl);
-        child.parent = this;
-        this->children.push_back(child);
+    const std::string& name(uint32_t id) const {
+        return names[id];
     }
 
-    void create_children_from_db(const int& max_depth) {
-        if(this->depth >= max_depth) return;
+    //returns nullptr if the request failed. failures are not remembered, the node is requested again next time
+    //the list stays valid until the next call
+    const std::vector<uint32_t>* neighbors_of(uint32_t id) {
+        if(fetched[id]) {
+            repeats++;
+            return &neighbors[id];
+        }
 
-        std::string json_result = run_curl(this->curl, value);
+        std::string json_result = run_curl(curl, names[id]);
         if(json_result.empty()) {
+            return nullptr;
+        }
+        fetches++;
+
+        std::vector<uint32_t> list;
+        for(const std::string& s: parse_neighbors(json_result)) {
+            list.push_back(intern(s));
+        }
+        neighbors[id] = std::move(list);
+        fetched[id] = true;
+        return &neighbors[id];
+    }
+};
+
+//children of a node are created together, so they sit next to each other in the pool
+struct Node {
+    uint32_t name;
+    int depth;
+    uint32_t first_child;
+    uint32_t num_children;
+};
+
+// Tree of every path of up to max_depth edges from the root that does not repeat a node.
+// Nodes live in one flat pool and refer to their children by index, so growing the tree never copies subtrees
+class Tree {
+    NeighborMemo& memo;
+    std::vector<Node> pool;
+    //names on the path from the root to the node being expanded, for the cycle check
+    std::unordered_set<uint32_t> path;
+
+    void create_children(uint32_t index, const int& max_depth) {
+        if(pool[index].depth >= max_depth) return;
+
+        const std::vector<uint32_t>* neighbors = memo.neighbors_of(pool[index].name);
+        if(!neighbors) {
             return;
         }
-        std::vector<std::string> neighbors = parse_neighbors(json_result);
 
         //create children for this node
-        for(std::string& s: neighbors) {
-            if(value_exists(s)) continue;
+        path.insert(pool[index].name);
+        uint32_t first = pool.size();
+        for(uint32_t n: *neighbors) {
+            if(path.count(n)) continue;
 
-            this->create_child(s);
+            pool.push_back(Node{n, pool[index].depth + 1, 0, 0});
         }
+        uint32_t count = pool.size() - first;
+        pool[index].first_child = first;
+        pool[index].num_children = count;
 
         //have all children create their own trees
-        for(Node& c: this->children) {
-            c.create_children_from_db(max_depth);
+        for(uint32_t c = first; c < first + count; c++) {
+            create_children(c, max_depth);
         }
+        path.erase(pool[index].name);
     }
 
-    std::string to_string() {
+    std::string to_string(uint32_t index) {
         std::stringstream ret;
-        ret<<value<<", depth="<<depth<<", num children="<<this->children.size()<<"\n";
+        ret<<memo.name(pool[index].name)<<", depth="<<pool[index].depth<<", num children="<<pool[index].num_children<<"\n";
         return ret.str();
     }
 
-    void print_tree(std::string indent) {
-        std::cout<<indent<<this->to_string();
-        for(Node& c: this->children) {
-            c.print_tree(indent + indent);
+    void write_subtree(std::ostream& outstream, uint32_t index, std::string indent) {
+        outstream<<indent<<to_string(index);
+        for(uint32_t c = pool[index].first_child; c < pool[index].first_child + pool[index].num_children; c++) {
+            write_subtree(outstream, c, indent + indent);
         }
     }
 
+    public:
+
+    Tree(NeighborMemo& memo, const std::string& root) : memo(memo) {
+        pool.push_back(Node{memo.intern(root), 0, 0, 0});
+    }
+
+    void create_children_from_db(const int& max_depth) {
+        create_children(0, max_depth);
+    }
+
+    size_t size() const {
+        return pool.size();
+    }
+
+    void print_tree(std::string indent) {
+        write_subtree(std::cout, 0, indent);
+    }
+
     void write_tree(std::ofstream& outstream, std::string indent) {
-        outstream<<indent<<this->to_string();
-        for(Node& c: this->children) {
-            c.write_tree(outstream, indent + indent);
-        }
+        write_subtree(outstream, 0, indent);
     }
 };
 
@@ -195,14 +263,15 @@ int main(int argc, char* argv[]) {
 
     CURL* curl = curl_easy_init();
 
-    Node parent = Node(parent_value, 0, curl);
+    NeighborMemo memo(curl);
+    Tree tree(memo, parent_value);
 
 
     //time execution
     namespace chrn = std::chrono;
     auto start = chrn::high_resolution_clock::now();
 
-    parent.create_children_from_db(max_depth);
+    tree.create_children_from_db(max_depth);
 
     auto end = chrn::high_resolution_clock::now();
     auto elapsed_us = chrn::duration_cast<chrn::microseconds>(end - start).count();
@@ -217,8 +286,10 @@ int main(int argc, char* argv[]) {
     output_file.open(output_filepath, std::ios::out);
     output_file<<"Execution Time: "<<elapsed_ms<<"ms\n";
 
-    parent.write_tree(output_file, "\t");
+    tree.write_tree(output_file, "\t");
     output_file.close();
 
+    std::cout<<tree.size()<<" tree nodes, "<<memo.fetches<<" requests, "<<memo.repeats<<" repeated nodes served from memory\n";
+
     return 0;
 };
\ No newline at end of file
@@ -3,4 +3,4 @@
 #SBATCH --partition=Centaurus
 #SBATCH --time=00:40:00
 #SBATCH --mem=10G
-$HOME/parallelProgramming/seq-mergesort/seq-mergesort.out
+$HOME/parallelProgramming/seq-mergesort/seq-mergesort.out "$@"
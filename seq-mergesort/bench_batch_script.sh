@@ -0,0 +1,7 @@
+#!/bin/bash
+#SBATCH --job-name=sort-bench
+#SBATCH --partition=Centaurus
+#SBATCH --time=02:00:00
+#SBATCH --mem=10G
+#SBATCH --cpus-per-task=16
+$HOME/parallelProgramming/seq-mergesort/sort-bench.out "$@"
@@ -0,0 +1,296 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+// Top-down binary mergesort. Works on any T with operator<=, and equal elements keep their order.
+// Indices are 64-bit (std::ptrdiff_t) so arrays past 2^31 elements can be sorted
+
+template <typename T>
+void verify_sorted(const std::vector<T>& arr) {
+    for(size_t i = 1; i < arr.size(); i++) {
+        if(!(arr[i-1] <= arr[i])) {
+            std::cout<<"NOT SORTED\n";
+            return;
+        }
+    }
+    std::cout<<"Sorted successfully\n";
+}
+
+//merges [left, mid] and [mid+1, right] through two temporary vectors, so it needs right-left+1 extra elements.
+//merge_in_place below is the O(1) extra memory version
+template <typename T>
+void merge_vectors_inplace(std::vector<T>& arr, std::ptrdiff_t left, std::ptrdiff_t mid, std::ptrdiff_t right) {
+    //half1 is from [left, mid], half2 is from [mid+1, right]
+    std::ptrdiff_t half1_n = mid - left + 1;
+    std::ptrdiff_t half2_n = right - mid;
+
+    //copy values to temporary vectors
+    std::vector<T> half1;
+    half1.reserve(half1_n);
+    for(std::ptrdiff_t i = left; i <= mid; i++) {
+        half1.push_back(arr[i]);
+    }
+
+    std::vector<T> half2;
+    half2.reserve(half2_n);
+    for(std::ptrdiff_t i = mid+1; i <= right; i++) {
+        half2.push_back(arr[i]);
+    }
+
+    //merge temp vectors back to original vector
+    size_t half1_i = 0; size_t half2_i = 0; std::ptrdiff_t arr_i = left;
+
+    while(half1_i < half1.size() && half2_i < half2.size()) {
+        if(half1[half1_i] <= half2[half2_i]) {
+            arr[arr_i] = half1[half1_i];
+            half1_i++;
+            arr_i++;
+        } else {
+            arr[arr_i] = half2[half2_i];
+            half2_i++;
+            arr_i++;
+        }
+    }
+    //add remaining elements once one array has been traversed
+    while(half1_i < half1.size()) {
+        arr[arr_i] = half1[half1_i];
+            half1_i++;
+            arr_i++;
+    }
+    while(half2_i < half2.size()) {
+        arr[arr_i] = half2[half2_i];
+            half2_i++;
+            arr_i++;
+    }
+}
+
+template <typename T>
+void merge_sort(std::vector<T>& arr, std::ptrdiff_t left, std::ptrdiff_t right) {
+
+    //trigger end of recursive divide
+    if(left >= right) {
+        return;
+    }
+
+    std::ptrdiff_t mid = left + (right - left) / 2;
+    merge_sort(arr, left, mid);
+    merge_sort(arr, mid+1, right);
+    merge_vectors_inplace(arr, left, mid, right);
+}
+
+// Stable merge of the sorted ranges [first, middle) and [middle, last) with O(1) extra memory
+// (SymMerge, Kim & Kutzner 2004). The two ranges are split around a symmetric point found by binary search,
+// the middle part is rotated into place and both halves are merged recursively. O(n log n) moves per merge,
+// recursion depth is O(log n)
+template <typename T>
+void merge_in_place(std::vector<T>& arr, size_t first, size_t middle, size_t last) {
+    if(first >= middle || middle >= last) return;
+
+    //a single element on either side is one binary search and one rotation
+    if(middle - first == 1) {
+        //first position in [middle, last) that is not smaller than arr[first]
+        size_t pos = std::lower_bound(arr.begin() + middle, arr.begin() + last, arr[first],
+                                      [](const T& a, const T& b) { return !(b <= a); }) - arr.begin();
+        std::rotate(arr.begin() + first, arr.begin() + first + 1, arr.begin() + pos);
+        return;
+    }
+    if(last - middle == 1) {
+        //first position in [first, middle) that is larger than arr[middle]
+        size_t pos = std::upper_bound(arr.begin() + first, arr.begin() + middle, arr[middle],
+                                      [](const T& a, const T& b) { return !(b <= a); }) - arr.begin();
+        std::rotate(arr.begin() + pos, arr.begin() + middle, arr.begin() + last);
+        return;
+    }
+
+    size_t mid = first + (last - first) / 2;
+    size_t n = mid + middle;
+    size_t start;
+    size_t r;
+    if(middle > mid) {
+        start = n - last;
+        r = mid;
+    } else {
+        start = first;
+        r = middle;
+    }
+    size_t p = n - 1;
+    while(start < r) {
+        size_t c = start + (r - start) / 2;
+        if(arr[c] <= arr[p - c]) {
+            start = c + 1;
+        } else {
+            r = c;
+        }
+    }
+
+    size_t end = n - start;
+    if(start < middle && middle < end) {
+        std::rotate(arr.begin() + start, arr.begin() + middle, arr.begin() + end);
+    }
+    merge_in_place(arr, first, start, mid);
+    merge_in_place(arr, mid, end, last);
+}
+
+// Bottom-up mergesort that only uses O(log n) stack and no heap memory: insertion sort on small blocks,
+// then merge_in_place. Slower than merge_sort (O(n log^2 n)), but the peak footprint is just the array
+template <typename T>
+void merge_sort_in_place(std::vector<T>& arr) {
+    const size_t INSERTION_BLOCK = 16;
+    size_t n = arr.size();
+
+    for(size_t block = 0; block < n; block += INSERTION_BLOCK) {
+        size_t block_end = std::min(block + INSERTION_BLOCK, n);
+        for(size_t i = block + 1; i < block_end; i++) {
+            for(size_t j = i; j > block && !(arr[j-1] <= arr[j]); j--) {
+                std::swap(arr[j-1], arr[j]);
+            }
+        }
+    }
+
+    for(size_t width = INSERTION_BLOCK; width < n; width *= 2) {
+        for(size_t left = 0; left + width < n; left += 2 * width) {
+            merge_in_place(arr, left, left + width, std::min(left + 2 * width, n));
+        }
+    }
+}
+
+// Free memory in the cgroup this process belongs to, the smallest of (limit - usage) over its cgroup and every
+// parent up to the root of the hierarchy. Slurm enforces --mem on the job's own cgroup
+// (e.g. /sys/fs/cgroup/system.slice/slurmstepd.scope/job_M), so the root's files alone usually say "max".
+// Handles cgroup v2 ("0::<path>" in /proc/self/cgroup) and v1 (the line of the memory controller), with the
+// mount point from /proc/self/mountinfo. Returns false if no level has a limit
+inline bool cgroup_free_bytes(uint64_t& free_bytes) {
+    auto read_number = [](const std::string& path, uint64_t& value) {
+        std::ifstream file(path);
+        std::string text;
+        if(!(file >> text) || text == "max") return false;
+        try {
+            value = std::stoull(text);
+        } catch (const std::exception& e) {
+            return false;
+        }
+        return true;
+    };
+
+    //this process's path in the v2 hierarchy, or in the v1 memory hierarchy
+    std::string v2_path, v1_path;
+    bool has_v2 = false, has_v1 = false;
+    std::ifstream cgroups("/proc/self/cgroup");
+    std::string line;
+    while(std::getline(cgroups, line)) {
+        size_t first = line.find(':');
+        size_t second = line.find(':', first + 1);
+        if(first == std::string::npos || second == std::string::npos) continue;
+        std::string controllers = line.substr(first + 1, second - first - 1);
+        std::string path = line.substr(second + 1);
+        if(line.compare(0, first, "0") == 0 && controllers.empty()) {
+            v2_path = path;
+            has_v2 = true;
+        }
+        std::stringstream list(controllers);
+        std::string controller;
+        while(std::getline(list, controller, ',')) {
+            if(controller == "memory") {
+                v1_path = path;
+                has_v1 = true;
+            }
+        }
+    }
+
+    //mount point and root of each hierarchy: fields 4 and 5 of mountinfo, the file system type after " - "
+    std::string mount, root;
+    bool v1 = false;
+    std::ifstream mountinfo("/proc/self/mountinfo");
+    while(std::getline(mountinfo, line)) {
+        size_t dash = line.find(" - ");
+        if(dash == std::string::npos) continue;
+        std::stringstream fields(line.substr(0, dash)), tail(line.substr(dash + 3));
+        std::string id, parent, device, mount_root, mount_point, fs_type, source, options;
+        fields >> id >> parent >> device >> mount_root >> mount_point;
+        tail >> fs_type >> source >> options;
+        if(has_v1 && fs_type == "cgroup" && ("," + options + ",").find(",memory,") != std::string::npos) {
+            mount = mount_point;
+            root = mount_root;
+            v1 = true;
+            break;
+        }
+        if(has_v2 && fs_type == "cgroup2" && mount.empty()) {
+            mount = mount_point;
+            root = mount_root;
+        }
+    }
+    if(mount.empty()) return false;
+
+    //the path is relative to the hierarchy's root, the mount may only show part of it
+    std::string path = v1 ? v1_path : v2_path;
+    if(root != "/" && path.compare(0, root.size(), root) == 0)
+        path = path.substr(root.size());
+    const char* limit_file = v1 ? "/memory.limit_in_bytes" : "/memory.max";
+    const char* usage_file = v1 ? "/memory.usage_in_bytes" : "/memory.current";
+
+    bool found = false;
+    while(true) {
+        std::string dir = mount + (path == "/" ? "" : path);
+        uint64_t limit, usage;
+        //v1 reports "no limit" as a huge number, which the min with MemAvailable takes care of
+        if(read_number(dir + limit_file, limit) && read_number(dir + usage_file, usage)) {
+            uint64_t level_free = limit > usage ? limit - usage : 0;
+            free_bytes = found ? std::min(free_bytes, level_free) : level_free;
+            found = true;
+        }
+        if(path.empty() || path == "/") break;
+        size_t slash = path.rfind('/');
+        path = slash == 0 || slash == std::string::npos ? "/" : path.substr(0, slash);
+    }
+    return found;
+}
+
+// Bytes this process may still allocate: the free memory of its cgroup if it has a limit, capped by
+// MemAvailable from /proc/meminfo. Returns SIZE_MAX if neither can be read
+inline size_t available_memory_bytes() {
+    uint64_t cgroup_free;
+    bool limited = cgroup_free_bytes(cgroup_free);
+
+    std::ifstream meminfo("/proc/meminfo");
+    std::string line;
+    while(std::getline(meminfo, line)) {
+        if(line.rfind("MemAvailable:", 0) == 0) {
+            size_t available = size_t(std::stoull(line.substr(13))) * 1024;
+            return limited ? std::min<size_t>(cgroup_free, available) : available;
+        }
+    }
+    return limited ? size_t(cgroup_free) : SIZE_MAX;
+}
+
+enum class MergeMemory {
+    //merge_sort with temporary vectors, peak extra memory is one copy of the array
+    buffered,
+    //merge_sort_in_place, no extra memory
+    in_place,
+    //buffered if a full copy of the array fits in available_memory_bytes(), in place otherwise
+    automatic,
+};
+
+// 64-bit sort API over the whole vector
+template <typename T>
+void merge_sort(std::vector<T>& arr, MergeMemory mode = MergeMemory::automatic) {
+    if(mode == MergeMemory::automatic) {
+        //keep some headroom, the allocator and the rest of the program need memory too
+        size_t needed = arr.size() * sizeof(T);
+        size_t available = available_memory_bytes();
+        mode = (needed < available - available / 8) ? MergeMemory::buffered : MergeMemory::in_place;
+    }
+
+    if(mode == MergeMemory::in_place) {
+        merge_sort_in_place(arr);
+    } else {
+        merge_sort(arr, 0, std::ptrdiff_t(arr.size()) - 1);
+    }
+}
@@ -0,0 +1,192 @@
+#include <mpi.h>
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <limits>
+#include <cstdint>
+#include <algorithm>
+
+#include "mergesort.h"
+#include "multiway_mergesort.h"
+
+// Distributed sample sort (parallel sorting by regular sampling).
+// 1. every rank sorts its shard with merge_sort
+// 2. every rank takes p regularly spaced samples, the p^2 samples are allgathered and sorted, and the
+//    p-1 splitters are taken at regular positions of that sample. This bounds every bucket by 2n/p
+// 3. each rank cuts its sorted shard at the splitters and the buckets are exchanged with MPI_Alltoallv
+// 4. each rank now holds p sorted runs and merges them in one pass through the loser tree
+// Run with: mpirun -np N ./mpi-samplesort.out <n_magnitude> [seed]
+
+//order-independent checksum of the keys, to check that no key was lost or duplicated in the exchange
+inline uint64_t mix_key(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+uint64_t local_checksum(const std::vector<int>& data) {
+    uint64_t sum = 0;
+    for(int x: data) sum += mix_key(uint64_t(uint32_t(x)));
+    return sum;
+}
+
+//p splitters-to-be from a sorted shard, at indices 0, n/p, 2n/p, ...
+std::vector<int> regular_samples(const std::vector<int>& sorted, int p) {
+    std::vector<int> samples(p, std::numeric_limits<int>::max());
+    if(sorted.empty()) return samples;
+    for(int i = 0; i < p; i++) {
+        samples[i] = sorted[sorted.size() * i / p];
+    }
+    return samples;
+}
+
+// True if every rank is sorted and each non-empty rank's first key is >= the last key of the previous non-empty rank
+bool globally_sorted(const std::vector<int>& local, int rank, int p) {
+    //has_data, first, last for each rank
+    long long mine[3] = {local.empty() ? 0 : 1, local.empty() ? 0 : local.front(), local.empty() ? 0 : local.back()};
+    int locally_sorted = std::is_sorted(local.begin(), local.end()) ? 1 : 0;
+    int all_locally_sorted = 0;
+    MPI_Allreduce(&locally_sorted, &all_locally_sorted, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+
+    std::vector<long long> bounds(3 * p);
+    MPI_Allgather(mine, 3, MPI_LONG_LONG, bounds.data(), 3, MPI_LONG_LONG, MPI_COMM_WORLD);
+
+    bool ok = all_locally_sorted == 1;
+    bool have_prev = false;
+    long long prev_last = 0;
+    for(int r = 0; r < p; r++) {
+        if(!bounds[3*r]) continue;
+        if(have_prev && bounds[3*r + 1] < prev_last) {
+            if(rank == 0) std::cerr << "Rank boundary " << r << " out of order\n";
+            ok = false;
+        }
+        prev_last = bounds[3*r + 2];
+        have_prev = true;
+    }
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    MPI_Init(&argc, &argv);
+    int rank, p;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &p);
+
+    if(argc < 2) {
+        if(rank == 0) std::cerr << "Usage: mpirun -np N " << argv[0] << " <n_magnitude> [seed]\n";
+        MPI_Finalize();
+        return 1;
+    }
+    int n_magnitude;
+    uint64_t seed = 1;
+    try {
+        n_magnitude = std::stoi(argv[1]);
+        if(argc > 2) seed = std::stoull(argv[2]);
+    } catch (const std::exception& e) {
+        if(rank == 0) std::cerr << "Error: n_magnitude and seed must be integers.\n";
+        MPI_Finalize();
+        return 1;
+    }
+
+    //generate this rank's shard of the 10^n_magnitude keys
+    uint64_t n_total = 1;
+    for(int i = 0; i < n_magnitude; i++) n_total *= 10;
+    size_t n_local = n_total / p + (uint64_t(rank) < n_total % p ? 1 : 0);
+    std::vector<int> local(n_local);
+    std::mt19937_64 gen(seed * 1000003 + rank);
+    for(int& x: local) x = int(gen());
+
+    uint64_t checksum_before = local_checksum(local);
+    uint64_t global_checksum_before = 0;
+    MPI_Allreduce(&checksum_before, &global_checksum_before, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double t_start = MPI_Wtime();
+
+    //1. local sort
+    merge_sort(local);
+    double t_local_sort = MPI_Wtime();
+
+    //2. regular sampling and splitter selection
+    std::vector<int> samples = regular_samples(local, p);
+    std::vector<int> all_samples(p * p);
+    MPI_Allgather(samples.data(), p, MPI_INT, all_samples.data(), p, MPI_INT, MPI_COMM_WORLD);
+    merge_sort(all_samples);
+    std::vector<int> splitters;
+    for(int j = 1; j < p; j++) {
+        splitters.push_back(all_samples[j * p + p / 2 - 1]);
+    }
+    double t_splitters = MPI_Wtime();
+
+    //3. cut the shard at the splitters and exchange buckets. keys equal to a splitter go to the lower bucket
+    std::vector<int> send_counts(p), send_displs(p);
+    size_t bucket_start = 0;
+    for(int j = 0; j < p; j++) {
+        size_t bucket_end = (j < p - 1) ? std::upper_bound(local.begin() + bucket_start, local.end(), splitters[j]) - local.begin()
+                                        : local.size();
+        send_displs[j] = int(bucket_start);
+        send_counts[j] = int(bucket_end - bucket_start);
+        bucket_start = bucket_end;
+    }
+
+    std::vector<int> recv_counts(p), recv_displs(p);
+    MPI_Alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    size_t n_received = 0;
+    for(int j = 0; j < p; j++) {
+        recv_displs[j] = int(n_received);
+        n_received += recv_counts[j];
+    }
+
+    std::vector<int> received(n_received);
+    MPI_Alltoallv(local.data(), send_counts.data(), send_displs.data(), MPI_INT,
+                  received.data(), recv_counts.data(), recv_displs.data(), MPI_INT, MPI_COMM_WORLD);
+    local = std::vector<int>();
+    double t_exchange = MPI_Wtime();
+
+    //4. one k-way merge of the p received runs
+    std::vector<std::pair<const int*, const int*>> runs;
+    for(int j = 0; j < p; j++) {
+        runs.emplace_back(received.data() + recv_displs[j], received.data() + recv_displs[j] + recv_counts[j]);
+    }
+    std::vector<int> sorted(n_received);
+    multiway_merge(runs, sorted.data());
+    received = std::vector<int>();
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double t_end = MPI_Wtime();
+
+    //phase times are reported as the slowest rank's
+    double phases[4] = {t_local_sort - t_start, t_splitters - t_local_sort, t_exchange - t_splitters, t_end - t_exchange};
+    double max_phases[4];
+    MPI_Reduce(phases, max_phases, 4, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    //load imbalance: largest final shard relative to the ideal n/p
+    unsigned long long my_count = sorted.size();
+    unsigned long long max_count = 0, min_count = 0;
+    MPI_Reduce(&my_count, &max_count, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&my_count, &min_count, 1, MPI_UNSIGNED_LONG_LONG, MPI_MIN, 0, MPI_COMM_WORLD);
+
+    bool sorted_ok = globally_sorted(sorted, rank, p);
+    uint64_t checksum_after = local_checksum(sorted);
+    uint64_t global_checksum_after = 0;
+    MPI_Allreduce(&checksum_after, &global_checksum_after, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    bool checksum_ok = global_checksum_after == global_checksum_before;
+
+    if(rank == 0) {
+        double ideal = double(n_total) / p;
+        std::cout << "n = 10^" << n_magnitude << " over " << p << " ranks, execution time: " << (t_end - t_start) * 1000 << " ms\n";
+        std::cout << "  local sort: " << max_phases[0] * 1000 << " ms, splitters: " << max_phases[1] * 1000
+                  << " ms, exchange: " << max_phases[2] * 1000 << " ms, merge: " << max_phases[3] * 1000 << " ms\n";
+        std::cout << "  keys per rank: min " << min_count << ", max " << max_count
+                  << ", imbalance (max / ideal): " << (ideal > 0 ? max_count / ideal : 1.0) << "\n";
+        std::cout << (sorted_ok && checksum_ok ? "Sorted successfully\n" : "NOT SORTED\n");
+    }
+
+    MPI_Finalize();
+    return (sorted_ok && checksum_ok) ? 0 : 1;
+}
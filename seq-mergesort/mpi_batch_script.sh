@@ -0,0 +1,8 @@
+#!/bin/bash
+#SBATCH --job-name=mpi-samplesort
+#SBATCH --partition=Centaurus
+#SBATCH --time=00:40:00
+#SBATCH --nodes=2
+#SBATCH --ntasks-per-node=16
+#SBATCH --mem=10G
+mpirun $HOME/parallelProgramming/seq-mergesort/mpi-samplesort.out "$@"
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <utility>
+#include <algorithm>
+#include <functional>
+
+//chunks are sized to stay resident in a typical 256KB L2 cache while they are sorted
+const size_t DEFAULT_CHUNK_BYTES = 256 * 1024;
+const size_t DEFAULT_MERGE_WAYS = 64;
+
+// Tournament tree of losers over k sorted runs.
+// Each internal node remembers the run that lost the match played there, and losers[0] holds the
+// overall winner, so replacing the winner only replays the log2(k) matches on its path to the root.
+template <typename T, typename Compare = std::less<T>>
+class LoserTree {
+    std::vector<const T*> heads;
+    std::vector<const T*> ends;
+    std::vector<size_t> losers;
+    size_t n_leaves;
+    Compare comp;
+
+    //leaves past the last real run act as runs that are already empty
+    bool exhausted(size_t run) const {
+        return run >= heads.size() || heads[run] == ends[run];
+    }
+
+    //true if run a should be output before run b. ties go to the lower run so the merge is stable
+    bool beats(size_t a, size_t b) const {
+        if(exhausted(a)) return false;
+        if(exhausted(b)) return true;
+        if(comp(*heads[a], *heads[b])) return true;
+        if(comp(*heads[b], *heads[a])) return false;
+        return a < b;
+    }
+
+    public:
+
+    LoserTree(const std::vector<std::pair<const T*, const T*>>& runs, Compare comp = Compare()) : comp(comp) {
+        for(const auto& run: runs) {
+            heads.push_back(run.first);
+            ends.push_back(run.second);
+        }
+
+        n_leaves = 1;
+        while(n_leaves < runs.size()) n_leaves *= 2;
+
+        //play the initial tournament bottom up. winners[] is only needed while building
+        std::vector<size_t> winners(2 * n_leaves);
+        losers.assign(n_leaves, 0);
+        for(size_t i = 0; i < n_leaves; i++) {
+            winners[n_leaves + i] = i;
+        }
+        for(size_t node = n_leaves - 1; node >= 1; node--) {
+            size_t a = winners[2 * node];
+            size_t b = winners[2 * node + 1];
+            if(beats(a, b)) {
+                winners[node] = a;
+                losers[node] = b;
+            } else {
+                winners[node] = b;
+                losers[node] = a;
+            }
+        }
+        losers[0] = (n_leaves == 1) ? 0 : winners[1];
+    }
+
+    bool empty() const {
+        return exhausted(losers[0]);
+    }
+
+    const T& top() const {
+        return *heads[losers[0]];
+    }
+
+    void pop() {
+        size_t winner = losers[0];
+        heads[winner]++;
+
+        //replay the matches from the winner's leaf up to the root
+        for(size_t node = (winner + n_leaves) / 2; node >= 1; node /= 2) {
+            if(beats(losers[node], winner)) {
+                std::swap(losers[node], winner);
+            }
+        }
+        losers[0] = winner;
+    }
+};
+
+// Merges any number of sorted runs into out in a single pass. Returns one past the last element written
+template <typename T, typename Compare = std::less<T>>
+T* multiway_merge(const std::vector<std::pair<const T*, const T*>>& runs, T* out, Compare comp = Compare()) {
+    LoserTree<T, Compare> tree(runs, comp);
+    while(!tree.empty()) {
+        *out = tree.top();
+        out++;
+        tree.pop();
+    }
+    return out;
+}
+
+// Stable bottom-up mergesort of one cache-sized chunk, using scratch (at least n elements) as the
+// ping-pong buffer. The sorted result always ends up back in data
+template <typename T, typename Compare>
+void sort_chunk(T* data, T* scratch, size_t n, Compare comp) {
+    const size_t INSERTION_BLOCK = 16;
+
+    //insertion sort small blocks first, merging 1-element runs is mostly overhead
+    for(size_t block = 0; block < n; block += INSERTION_BLOCK) {
+        size_t block_end = std::min(block + INSERTION_BLOCK, n);
+        for(size_t i = block + 1; i < block_end; i++) {
+            T value = data[i];
+            size_t j = i;
+            while(j > block && comp(value, data[j-1])) {
+                data[j] = data[j-1];
+                j--;
+            }
+            data[j] = value;
+        }
+    }
+
+    T* src = data;
+    T* dst = scratch;
+    for(size_t width = INSERTION_BLOCK; width < n; width *= 2) {
+        for(size_t left = 0; left < n; left += 2 * width) {
+            size_t mid = std::min(left + width, n);
+            size_t right = std::min(left + 2 * width, n);
+            std::merge(src + left, src + mid, src + mid, src + right, dst + left, comp);
+        }
+        std::swap(src, dst);
+    }
+
+    if(src != data) {
+        std::copy(src, src + n, data);
+    }
+}
+
+struct MultiwayStats {
+    size_t k;
+    size_t chunk_elems;
+    size_t n_chunks;
+    size_t merge_passes;
+    //modelled memory traffic: every pass over the array reads and writes each element once
+    double bytes_per_element;
+};
+
+// k-way mergesort. Sorts chunks of chunk_elems elements in cache, then merges up to k chunks at a time
+// through a loser tree, so the whole array is streamed through memory 1 + ceil(log_k(n_chunks)) times
+// instead of the ~log2(n) times binary merge_sort needs.
+// chunk_elems = 0 picks a chunk that fits in DEFAULT_CHUNK_BYTES
+template <typename T, typename Compare = std::less<T>>
+MultiwayStats multiway_merge_sort(std::vector<T>& arr, size_t k = DEFAULT_MERGE_WAYS, size_t chunk_elems = 0, Compare comp = Compare()) {
+    MultiwayStats stats;
+    if(k < 2) k = 2;
+    if(chunk_elems == 0) chunk_elems = std::max<size_t>(DEFAULT_CHUNK_BYTES / sizeof(T), 1);
+
+    size_t n = arr.size();
+    stats.k = k;
+    stats.chunk_elems = chunk_elems;
+    stats.n_chunks = (n + chunk_elems - 1) / chunk_elems;
+    stats.merge_passes = 0;
+    stats.bytes_per_element = 0;
+    if(n < 2) return stats;
+
+    //phase 1: sort each chunk while it is in cache. the scratch buffer is reused so it stays cached too
+    std::vector<T> chunk_scratch(std::min(chunk_elems, n));
+    std::vector<std::pair<size_t, size_t>> runs;
+    for(size_t start = 0; start < n; start += chunk_elems) {
+        size_t len = std::min(chunk_elems, n - start);
+        sort_chunk(arr.data() + start, chunk_scratch.data(), len, comp);
+        runs.emplace_back(start, start + len);
+    }
+    chunk_scratch = std::vector<T>();
+
+    //phase 2: merge groups of k runs per pass, ping-ponging between arr and buffer
+    std::vector<T> buffer;
+    if(runs.size() > 1) buffer.resize(n);
+    T* src = arr.data();
+    T* dst = buffer.data();
+
+    while(runs.size() > 1) {
+        std::vector<std::pair<size_t, size_t>> merged_runs;
+        for(size_t group = 0; group < runs.size(); group += k) {
+            size_t group_end = std::min(group + k, runs.size());
+            std::vector<std::pair<const T*, const T*>> group_runs;
+            for(size_t r = group; r < group_end; r++) {
+                group_runs.emplace_back(src + runs[r].first, src + runs[r].second);
+            }
+            multiway_merge(group_runs, dst + runs[group].first, comp);
+            merged_runs.emplace_back(runs[group].first, runs[group_end-1].second);
+        }
+        runs = merged_runs;
+        std::swap(src, dst);
+        stats.merge_passes++;
+    }
+
+    //an odd number of passes leaves the result in buffer, swapping the vectors is O(1)
+    if(src != arr.data()) {
+        arr.swap(buffer);
+    }
+
+    stats.bytes_per_element = 2.0 * sizeof(T) * (1 + stats.merge_passes);
+    return stats;
+}
+
+// Modelled memory traffic of the binary merge_sort in seq-mergesort.cpp: at each of the ceil(log2(n))
+// levels every element is copied out to a half vector and merged back, i.e. two reads and two writes
+template <typename T>
+double binary_merge_bytes_per_element(size_t n) {
+    size_t levels = 0;
+    while((size_t(1) << levels) < n) levels++;
+    return 4.0 * sizeof(T) * levels;
+}
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <functional>
+
+// Adaptive natural mergesort in the style of TimSort, with the powersort merge policy.
+// Existing ascending runs are used as they are, strictly descending runs are reversed, and runs shorter than
+// min_run are extended with binary insertion sort. Runs are merged with galloping, so an input made of a
+// few long runs (e.g. timestamped logs with some late arrivals) sorts in close to linear time
+
+//once one side wins this many comparisons in a row, the merge switches to exponential search
+const size_t MIN_GALLOP = 7;
+
+// First position in [first, last) where pred is false, for a pred that is true on a prefix.
+// Probes positions 0, 1, 3, 7, ... from the front before binary searching, so it is O(log k) for an answer k away
+template <typename It, typename Pred>
+It gallop_front(It first, It last, Pred pred) {
+    size_t n = last - first;
+    size_t lo = 0;
+    size_t probe = 0;
+    while(true) {
+        if(probe >= n) return std::partition_point(first + lo, last, pred);
+        if(!pred(first[probe])) return std::partition_point(first + lo, first + probe, pred);
+        lo = probe + 1;
+        probe = 2 * probe + 1;
+    }
+}
+
+// Same as gallop_front, but probes from the back, for answers expected near the end of the range
+template <typename It, typename Pred>
+It gallop_back(It first, It last, Pred pred) {
+    size_t n = last - first;
+    size_t hi = n;
+    size_t step = 1;
+    while(true) {
+        if(step > n) return std::partition_point(first, first + hi, pred);
+        size_t probe = n - step;
+        if(pred(first[probe])) return std::partition_point(first + probe + 1, first + hi, pred);
+        hi = probe;
+        step *= 2;
+    }
+}
+
+template <typename T, typename Compare>
+class NaturalMergeSorter {
+    struct Run {
+        size_t start;
+        size_t len;
+    };
+
+    std::vector<T>& arr;
+    Compare comp;
+    std::vector<T> tmp;
+
+    //run lengths below this get extended with binary insertion sort. between 32 and 64, chosen so n / min_run
+    //is at or just below a power of two, which keeps the merges balanced on random data
+    static size_t compute_min_run(size_t n) {
+        size_t low_bits = 0;
+        while(n >= 64) {
+            low_bits |= n & 1;
+            n >>= 1;
+        }
+        return n + low_bits;
+    }
+
+    //powersort node power of the boundary between run a and the run of length len_b that follows it
+    static int node_power(size_t start_a, size_t len_a, size_t len_b, size_t n) {
+        //twice the midpoints of both runs, so everything stays in integers
+        size_t a = 2 * start_a + len_a;
+        size_t b = a + len_a + len_b;
+        int power = 0;
+        while(true) {
+            power++;
+            if(a >= n) {
+                a -= n;
+                b -= n;
+            } else if(b >= n) {
+                break;
+            }
+            a <<= 1;
+            b <<= 1;
+        }
+        return power;
+    }
+
+    //length of the run starting at start. strictly descending runs are reversed in place (strict so that
+    //reversing never reorders equal elements)
+    size_t count_run(size_t start, size_t n) {
+        size_t end = start + 1;
+        if(end == n) return 1;
+
+        if(comp(arr[end], arr[start])) {
+            while(end < n && comp(arr[end], arr[end-1])) end++;
+            std::reverse(arr.begin() + start, arr.begin() + end);
+        } else {
+            while(end < n && !comp(arr[end], arr[end-1])) end++;
+        }
+        return end - start;
+    }
+
+    //extends the sorted range [start, sorted_end) to [start, end)
+    void binary_insertion_sort(size_t start, size_t sorted_end, size_t end) {
+        for(size_t i = sorted_end; i < end; i++) {
+            T value = std::move(arr[i]);
+            auto pos = std::upper_bound(arr.begin() + start, arr.begin() + i, value, comp);
+            std::move_backward(pos, arr.begin() + i, arr.begin() + i + 1);
+            *pos = std::move(value);
+        }
+    }
+
+    //merge with the shorter left run [lo, mid) copied out, filling from the front
+    void merge_lo(size_t lo, size_t mid, size_t hi) {
+        size_t na = mid - lo;
+        std::move(arr.begin() + lo, arr.begin() + mid, tmp.begin());
+        T* a = tmp.data();
+        T* a_end = a + na;
+        T* b = arr.data() + mid;
+        T* b_end = arr.data() + hi;
+        T* out = arr.data() + lo;
+
+        while(a < a_end && b < b_end) {
+            size_t a_wins = 0;
+            size_t b_wins = 0;
+            while(a < a_end && b < b_end && a_wins < MIN_GALLOP && b_wins < MIN_GALLOP) {
+                //ties go to the left run to stay stable
+                if(comp(*b, *a)) {
+                    *out++ = std::move(*b++);
+                    b_wins++;
+                    a_wins = 0;
+                } else {
+                    *out++ = std::move(*a++);
+                    a_wins++;
+                    b_wins = 0;
+                }
+            }
+
+            //galloping: copy whole blocks that are known to come before the other run's head
+            while(a < a_end && b < b_end) {
+                T* a_stop = gallop_front(a, a_end, [&](const T& x) { return !comp(*b, x); });
+                size_t ka = a_stop - a;
+                out = std::move(a, a_stop, out);
+                a = a_stop;
+                if(a == a_end) break;
+
+                T* b_stop = gallop_front(b, b_end, [&](const T& x) { return comp(x, *a); });
+                size_t kb = b_stop - b;
+                out = std::move(b, b_stop, out);
+                b = b_stop;
+
+                if(ka < MIN_GALLOP && kb < MIN_GALLOP) break;
+            }
+        }
+
+        //whatever is left of the right run is already in place
+        std::move(a, a_end, out);
+    }
+
+    //merge with the shorter right run [mid, hi) copied out, filling from the back
+    void merge_hi(size_t lo, size_t mid, size_t hi) {
+        size_t nb = hi - mid;
+        std::move(arr.begin() + mid, arr.begin() + hi, tmp.begin());
+        T* a_begin = arr.data() + lo;
+        T* a_end = arr.data() + mid;
+        T* b_begin = tmp.data();
+        T* b_end = b_begin + nb;
+        T* out = arr.data() + hi;
+
+        while(a_end > a_begin && b_end > b_begin) {
+            size_t a_wins = 0;
+            size_t b_wins = 0;
+            while(a_end > a_begin && b_end > b_begin && a_wins < MIN_GALLOP && b_wins < MIN_GALLOP) {
+                //going backwards, ties go to the right run
+                if(comp(*(b_end-1), *(a_end-1))) {
+                    *--out = std::move(*--a_end);
+                    a_wins++;
+                    b_wins = 0;
+                } else {
+                    *--out = std::move(*--b_end);
+                    b_wins++;
+                    a_wins = 0;
+                }
+            }
+
+            while(a_end > a_begin && b_end > b_begin) {
+                T* a_stop = gallop_back(a_begin, a_end, [&](const T& x) { return !comp(*(b_end-1), x); });
+                size_t ka = a_end - a_stop;
+                out = std::move_backward(a_stop, a_end, out);
+                a_end = a_stop;
+                if(a_end == a_begin) break;
+
+                T* b_stop = gallop_back(b_begin, b_end, [&](const T& x) { return comp(x, *(a_end-1)); });
+                size_t kb = b_end - b_stop;
+                out = std::move_backward(b_stop, b_end, out);
+                b_end = b_stop;
+
+                if(ka < MIN_GALLOP && kb < MIN_GALLOP) break;
+            }
+        }
+
+        std::move_backward(b_begin, b_end, out);
+    }
+
+    void merge_runs(size_t lo, size_t mid, size_t hi) {
+        //elements of the left run that are <= the right run's first element are already in place
+        lo = gallop_front(arr.data() + lo, arr.data() + mid, [&](const T& x) { return !comp(arr[mid], x); }) - arr.data();
+        if(lo == mid) return;
+        //and so are elements of the right run that are >= the left run's last element
+        hi = gallop_back(arr.data() + mid, arr.data() + hi, [&](const T& x) { return comp(x, arr[mid-1]); }) - arr.data();
+        if(hi == mid) return;
+
+        if(mid - lo <= hi - mid) {
+            merge_lo(lo, mid, hi);
+        } else {
+            merge_hi(lo, mid, hi);
+        }
+    }
+
+    public:
+
+    NaturalMergeSorter(std::vector<T>& arr, Compare comp) : arr(arr), comp(comp) {
+    }
+
+    void sort() {
+        size_t n = arr.size();
+        if(n < 2) return;
+
+        size_t min_run = compute_min_run(n);
+        tmp.resize(n / 2 + 1);
+
+        //run stack, powers[i] is the node power of the boundary between runs[i] and runs[i+1]
+        std::vector<Run> runs;
+        std::vector<int> powers;
+
+        size_t start = 0;
+        while(start < n) {
+            size_t len = count_run(start, n);
+            if(len < min_run) {
+                size_t end = std::min(start + min_run, n);
+                binary_insertion_sort(start, start + len, end);
+                len = end - start;
+            }
+
+            if(!runs.empty()) {
+                int power = node_power(runs.back().start, runs.back().len, len, n);
+                while(!powers.empty() && powers.back() > power) {
+                    Run right = runs.back();
+                    runs.pop_back();
+                    Run& left = runs.back();
+                    merge_runs(left.start, right.start, right.start + right.len);
+                    left.len += right.len;
+                    powers.pop_back();
+                }
+                powers.push_back(power);
+            }
+            runs.push_back({start, len});
+            start += len;
+        }
+
+        while(runs.size() > 1) {
+            Run right = runs.back();
+            runs.pop_back();
+            Run& left = runs.back();
+            merge_runs(left.start, right.start, right.start + right.len);
+            left.len += right.len;
+        }
+    }
+};
+
+// Stable, adaptive O(n + n log(runs)) mergesort
+template <typename T, typename Compare = std::less<T>>
+void natural_merge_sort(std::vector<T>& arr, Compare comp = Compare()) {
+    NaturalMergeSorter<T, Compare> sorter(arr, comp);
+    sorter.sort();
+}
@@ -3,15 +3,9 @@ import numpy as np
 import pandas as pd
 import matplotlib.pyplot as plt
 
-def main():
-    if len(sys.argv) < 2:
-        print("Please include path to .csv file as command line argument")
-        exit(0)
-
+def plot_execution_times(df):
     f = plt.figure()
 
-    df = pd.read_csv(sys.argv[1])
-
     n_labels = []
     n_magnitudes = df['n_magnitude'].tolist()
     for num in n_magnitudes:
@@ -27,6 +21,47 @@ def main():
 
     f.savefig("plot.pdf")
 
+def plot_benchmark(df):
+    # one subplot per input distribution, one line per sort with the p10-p90 range shaded
+    distributions = df['distribution'].unique().tolist()
+    n_cols = 2
+    n_rows = (len(distributions) + n_cols - 1) // n_cols
+    f, axes = plt.subplots(n_rows, n_cols, figsize=(6 * n_cols, 4 * n_rows), squeeze=False)
+
+    for i, dist in enumerate(distributions):
+        ax = axes[i // n_cols][i % n_cols]
+        dist_df = df[df['distribution'] == dist]
+        for algorithm in dist_df['algorithm'].unique():
+            algo_df = dist_df[dist_df['algorithm'] == algorithm].sort_values('n')
+            line, = ax.plot(algo_df['n'], algo_df['median_ms'], marker='o', label=algorithm)
+            ax.fill_between(algo_df['n'], algo_df['p10_ms'], algo_df['p90_ms'], color=line.get_color(), alpha=0.2)
+        ax.set_xscale('log')
+        ax.set_yscale('log')
+        ax.set_xlabel('N Elements')
+        ax.set_ylabel('Median time (ms)')
+        ax.set_title(f"{dist} ({dist_df['key_bits'].iloc[0]}-bit keys)")
+        ax.legend(fontsize='small')
+
+    # hide unused subplots
+    for i in range(len(distributions), n_rows * n_cols):
+        axes[i // n_cols][i % n_cols].axis('off')
+
+    f.tight_layout()
+    f.savefig("bench_plot.pdf")
+
+def main():
+    if len(sys.argv) < 2:
+        print("Please include path to .csv file as command line argument")
+        exit(0)
+
+    df = pd.read_csv(sys.argv[1])
+
+    # sort-bench.out writes one row per (algorithm, distribution, n), seq-mergesort.out one row per size
+    if 'algorithm' in df.columns:
+        plot_benchmark(df)
+    else:
+        plot_execution_times(df)
+
 
 if __name__ == "__main__":
-    main()
\ No newline at end of file
+    main()
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+#include <type_traits>
+
+//below this many elements per thread, starting threads costs more than it saves
+const size_t RADIX_MIN_ELEMENTS_PER_THREAD = 1 << 16;
+//each software write-combining buffer holds one cache line worth of elements per bucket
+const size_t RADIX_WC_BYTES = 64;
+
+// Unsigned integer type with the same width as K, used as the radix key
+template <typename K>
+using radix_bits_t = std::conditional_t<sizeof(K) == 1, uint8_t,
+                     std::conditional_t<sizeof(K) == 2, uint16_t,
+                     std::conditional_t<sizeof(K) == 4, uint32_t, uint64_t>>>;
+
+// True for the key types the radix engine can order by their bits
+template <typename K>
+constexpr bool radix_sortable_v = (std::is_integral_v<K> && !std::is_same_v<K, bool>)
+                               || (std::is_floating_point_v<K> && (sizeof(K) == 4 || sizeof(K) == 8));
+
+// Maps a key to an unsigned integer whose unsigned order matches the key's order.
+// Signed integers get their sign bit flipped. Negative floats have every bit flipped so larger magnitudes
+// sort first, positive floats only have the sign bit set. NaNs end up at the extremes
+template <typename K>
+radix_bits_t<K> radix_encode(K key) {
+    using U = radix_bits_t<K>;
+    const U sign_bit = U(1) << (8 * sizeof(U) - 1);
+
+    U bits;
+    std::memcpy(&bits, &key, sizeof(U));
+    if constexpr (std::is_floating_point_v<K>) {
+        return (bits & sign_bit) ? U(~bits) : U(bits | sign_bit);
+    } else if constexpr (std::is_signed_v<K>) {
+        return U(bits ^ sign_bit);
+    } else {
+        return bits;
+    }
+}
+
+//starts n_threads threads running f(thread_index) and waits for all of them
+template <typename F>
+void run_threads(int n_threads, F f) {
+    if(n_threads == 1) {
+        f(0);
+        return;
+    }
+    std::vector<std::thread> threadgroup;
+    for(int t = 0; t < n_threads; t++) {
+        threadgroup.push_back(std::thread(f, t));
+    }
+    for(auto& t: threadgroup) {
+        t.join();
+    }
+}
+
+// Parallel LSD radix sort of arbitrary elements by an unsigned key, key_of(element).
+// Each pass, every thread histograms the digit over its own contiguous block, the histograms are prefix
+// summed into per-thread bucket offsets, and every thread scatters its block through write-combining buffers
+// so each store to the destination is a full cache line. Keys up to 16 bits use 8-bit digits, wider keys
+// use 11-bit digits (3 passes for 32-bit keys). Passes where every key has the same digit are skipped.
+// Stable, so it can also carry values along with their keys
+template <typename Elem, typename KeyFn>
+void radix_sort_by(std::vector<Elem>& data, KeyFn key_of, int n_threads = 0) {
+    using U = decltype(key_of(data[0]));
+    const int KEY_BITS = 8 * sizeof(U);
+    const int DIGIT_BITS = (KEY_BITS <= 16) ? 8 : 11;
+    const size_t N_BUCKETS = size_t(1) << DIGIT_BITS;
+    const size_t WC_ELEMS = std::max<size_t>(RADIX_WC_BYTES / sizeof(Elem), 1);
+
+    size_t n = data.size();
+    if(n < 2) return;
+
+    if(n_threads <= 0) n_threads = std::max(1u, std::thread::hardware_concurrency());
+    n_threads = int(std::min<size_t>(n_threads, std::max<size_t>(n / RADIX_MIN_ELEMENTS_PER_THREAD, 1)));
+
+    //thread t owns [block_start[t], block_start[t+1])
+    std::vector<size_t> block_start(n_threads + 1);
+    for(int t = 0; t <= n_threads; t++) {
+        block_start[t] = n * t / n_threads;
+    }
+
+    std::vector<Elem> buffer(n);
+    Elem* src = data.data();
+    Elem* dst = buffer.data();
+    std::vector<std::vector<size_t>> offsets(n_threads, std::vector<size_t>(N_BUCKETS));
+
+    for(int shift = 0; shift < KEY_BITS; shift += DIGIT_BITS) {
+        auto digit_of = [&](const Elem& e) {
+            return size_t(key_of(e) >> shift) & (N_BUCKETS - 1);
+        };
+
+        //per-thread histograms, no sharing between threads
+        run_threads(n_threads, [&](int t) {
+            std::vector<size_t>& hist = offsets[t];
+            std::fill(hist.begin(), hist.end(), 0);
+            for(size_t i = block_start[t]; i < block_start[t+1]; i++) {
+                hist[digit_of(src[i])]++;
+            }
+        });
+
+        //exclusive prefix sum over (bucket, thread) turns the counts into each thread's write positions
+        size_t running = 0;
+        bool trivial_pass = false;
+        for(size_t b = 0; b < N_BUCKETS; b++) {
+            size_t bucket_total = 0;
+            for(int t = 0; t < n_threads; t++) {
+                size_t count = offsets[t][b];
+                offsets[t][b] = running;
+                running += count;
+                bucket_total += count;
+            }
+            if(bucket_total == n) trivial_pass = true;
+        }
+        if(trivial_pass) continue;
+
+        run_threads(n_threads, [&](int t) {
+            std::vector<size_t>& out = offsets[t];
+            std::vector<Elem> wc(N_BUCKETS * WC_ELEMS);
+            std::vector<size_t> wc_fill(N_BUCKETS, 0);
+
+            for(size_t i = block_start[t]; i < block_start[t+1]; i++) {
+                size_t b = digit_of(src[i]);
+                wc[b * WC_ELEMS + wc_fill[b]] = src[i];
+                wc_fill[b]++;
+                if(wc_fill[b] == WC_ELEMS) {
+                    std::copy(&wc[b * WC_ELEMS], &wc[b * WC_ELEMS] + WC_ELEMS, dst + out[b]);
+                    out[b] += WC_ELEMS;
+                    wc_fill[b] = 0;
+                }
+            }
+
+            //flush partially filled buffers
+            for(size_t b = 0; b < N_BUCKETS; b++) {
+                std::copy(&wc[b * WC_ELEMS], &wc[b * WC_ELEMS] + wc_fill[b], dst + out[b]);
+            }
+        });
+
+        std::swap(src, dst);
+    }
+
+    //an odd number of real passes leaves the result in buffer
+    if(src != data.data()) {
+        data.swap(buffer);
+    }
+}
+
+// Radix sorts integral or floating point keys
+template <typename K>
+void radix_sort(std::vector<K>& keys, int n_threads = 0) {
+    static_assert(radix_sortable_v<K>, "radix_sort needs integral or float/double keys");
+    radix_sort_by(keys, [](K key) { return radix_encode(key); }, n_threads);
+}
@@ -5,8 +5,13 @@
 #include <string>
 #include <chrono>
 
+#include "mergesort.h"
+#include "multiway_mergesort.h"
+
 void generate_data(std::vector<int>& result, int n_magnitude) {
-    for(int i = 0; i < pow(10, n_magnitude); i++) {
+    size_t n = size_t(pow(10, n_magnitude));
+    result.reserve(n);
+    for(size_t i = 0; i < n; i++) {
         result.push_back(rand());
     }
 }
@@ -18,101 +23,65 @@ void print_vector(const std::vector<int>& vector_to_print) {
     std::cout << "\n";
 }
 
-void verify_sorted(const std::vector<int>& arr) {
-    for(int i = 1; i < arr.size(); i++) {
-        if(arr[i-1] > arr[i]) {
-            std::cout<<"NOT SORTED\n";
-            return;
-        }
-    }
-    std::cout<<"Sorted successfully\n";
-}
-
-void merge_vectors_inplace(std::vector<int>& arr, int left, int mid, int right) {
-    //half1 is from [left, mid], half2 is from [mid+1, right]
-    int half1_n = mid - left + 1;
-    int half2_n = right - mid;
-
-    //copy values to temporary vectors
-    std::vector<int> half1;
-    half1.reserve(half1_n);
-    for(int i = left; i <= mid; i++) {
-        half1.push_back(arr[i]);
-    }
-
-    std::vector<int> half2;
-    half2.reserve(half2_n);
-    for(int i = mid+1; i <= right; i++) {
-        half2.push_back(arr[i]);
-    }
-
-    //merge temp vectors back to original vector
-    int half1_i = 0; int half2_i = 0; int arr_i = left;
+struct MergeResult {
+    double merge_ms;
+    double multiway_ms;
+    double merge_bytes_per_element;
+    MultiwayStats multiway;
+};
 
-    while(half1_i < half1.size() && half2_i < half2.size()) {
-        if(half1[half1_i] <= half2[half2_i]) {
-            arr[arr_i] = half1[half1_i];
-            half1_i++;
-            arr_i++;
-        } else {
-            arr[arr_i] = half2[half2_i];
-            half2_i++;
-            arr_i++;
-        }
-    }
-    //add remaining elements once one array has been traversed
-    while(half1_i < half1.size()) {
-        arr[arr_i] = half1[half1_i];
-            half1_i++;
-            arr_i++;
-    }
-    while(half2_i < half2.size()) {
-        arr[arr_i] = half2[half2_i];
-            half2_i++;
-            arr_i++;
-    }
-}
-
-void merge_sort(std::vector<int>& arr, int left, int right) {
-
-    //trigger end of recursive divide
-    if(left >= right) {
-        return;
-    }
-
-    int mid = left + (right - left) / 2;
-    merge_sort(arr, left, mid);
-    merge_sort(arr, mid+1, right);
-    merge_vectors_inplace(arr, left, mid, right);
-}
-
-double test_merge(int n_magnitude) {
+MergeResult test_merge(int n_magnitude, size_t k, size_t chunk_elems) {
     namespace chrn = std::chrono;
+    MergeResult result;
 
     std::vector<int> data;
     generate_data(data, n_magnitude);
+    std::vector<int> multiway_data = data;
 
     auto start = chrn::high_resolution_clock::now();
     merge_sort(data, 0, data.size()-1);
     auto end = chrn::high_resolution_clock::now();
     auto elapsed_us = chrn::duration_cast<chrn::microseconds>(end - start).count();
-    double elapsed_ms = elapsed_us / 1000.0;
+    result.merge_ms = elapsed_us / 1000.0;
+    result.merge_bytes_per_element = binary_merge_bytes_per_element<int>(data.size());
+
+    start = chrn::high_resolution_clock::now();
+    result.multiway = multiway_merge_sort(multiway_data, k, chunk_elems);
+    end = chrn::high_resolution_clock::now();
+    elapsed_us = chrn::duration_cast<chrn::microseconds>(end - start).count();
+    result.multiway_ms = elapsed_us / 1000.0;
     
     // print_vector(data);
-    // verify_sorted(data);
+    verify_sorted(data);
+    verify_sorted(multiway_data);
     
-    return elapsed_ms;
+    return result;
 }
 
 int main(int argc, char* argv[]) {
+    //optional args: number of ways for the multiway merge, and elements per cache-sized chunk (0 = auto)
+    size_t k = DEFAULT_MERGE_WAYS;
+    size_t chunk_elems = 0;
+    try {
+        if(argc > 1) k = std::stoul(argv[1]);
+        if(argc > 2) chunk_elems = std::stoul(argv[2]);
+    } catch (const std::exception& e) {
+        std::cerr << "Usage: " << argv[0] << " [merge_ways] [chunk_elems]\n";
+        return 1;
+    }
+
     std::ofstream csvFile("execution_times.csv");
-    csvFile<<"n_magnitude,execution_time_ms\n";
+    csvFile<<"n_magnitude,execution_time_ms,multiway_time_ms,merge_bytes_per_element,multiway_bytes_per_element,multiway_passes\n";
     
     for(int i = 1; i <= 9; i++) {
-        double elapsed_ms = test_merge(i);
+        MergeResult r = test_merge(i, k, chunk_elems);
 
-        std::cout<<"n = 10^" << i << ", execution time: " << elapsed_ms <<" ms\n";
-        csvFile<<i<<","<<elapsed_ms<<"\n";
+        std::cout<<"n = 10^" << i << ", execution time: " << r.merge_ms <<" ms"
+                 <<", " << k << "-way execution time: " << r.multiway_ms << " ms"
+                 <<", bytes moved per element: " << r.merge_bytes_per_element << " vs " << r.multiway.bytes_per_element
+                 <<" (" << r.multiway.merge_passes << " merge passes over " << r.multiway.n_chunks << " chunks)\n";
+        csvFile<<i<<","<<r.merge_ms<<","<<r.multiway_ms<<","<<r.merge_bytes_per_element<<","
+               <<r.multiway.bytes_per_element<<","<<r.multiway.merge_passes<<"\n";
 
     }
 
@@ -120,5 +89,3 @@ int main(int argc, char* argv[]) {
 
     return 0;
 }
-
-
@@ -0,0 +1,266 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+
+#include "sort_dispatch.h"
+#include "multiway_mergesort.h"
+#include "natural_mergesort.h"
+
+// Sorting benchmark suite. Every sort in this directory runs over several input distributions and sizes,
+// with warm-up runs and repeated timed trials. Every trial is verified (sorted, and same multiset of keys as
+// the input) and the timing percentiles are written to a csv that plotter.py can draw
+
+//data is generated in fixed size blocks, each with its own seed, so the input does not depend on the thread count
+const size_t GEN_BLOCK = 1 << 20;
+const uint64_t BASE_SEED = 12345;
+const size_t ZIPF_UNIVERSE = 1 << 16;
+const double ZIPF_EXPONENT = 1.0;
+const size_t FEW_UNIQUE_VALUES = 16;
+const size_t SAWTOOTH_TEETH = 64;
+
+enum class Distribution { uniform, sorted, reversed, sawtooth, few_unique, zipf };
+
+const std::vector<std::pair<Distribution, std::string>> DISTRIBUTIONS = {
+    {Distribution::uniform, "uniform"},
+    {Distribution::sorted, "sorted"},
+    {Distribution::reversed, "reversed"},
+    {Distribution::sawtooth, "sawtooth"},
+    {Distribution::few_unique, "few_unique"},
+    {Distribution::zipf, "zipf"},
+};
+
+int bench_threads() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+//cumulative distribution of ranks 1..ZIPF_UNIVERSE with P(rank) ~ 1/rank^s
+std::vector<double> zipf_cdf() {
+    std::vector<double> cdf(ZIPF_UNIVERSE);
+    double total = 0;
+    for(size_t rank = 1; rank <= ZIPF_UNIVERSE; rank++) {
+        total += 1.0 / std::pow(double(rank), ZIPF_EXPONENT);
+        cdf[rank-1] = total;
+    }
+    for(double& c: cdf) c /= total;
+    return cdf;
+}
+
+template <typename T>
+void generate_data(std::vector<T>& result, size_t n, Distribution dist) {
+    result.resize(n);
+    std::vector<double> cdf;
+    if(dist == Distribution::zipf) cdf = zipf_cdf();
+    size_t n_blocks = (n + GEN_BLOCK - 1) / GEN_BLOCK;
+    size_t tooth = std::max<size_t>(n / SAWTOOTH_TEETH, 1);
+
+    int n_threads = int(std::min<size_t>(bench_threads(), std::max<size_t>(n_blocks, 1)));
+    run_threads(n_threads, [&](int t) {
+        for(size_t block = t; block < n_blocks; block += n_threads) {
+            std::mt19937_64 gen(BASE_SEED * 1000003 + block);
+            std::uniform_real_distribution<double> unit(0.0, 1.0);
+            size_t end = std::min((block + 1) * GEN_BLOCK, n);
+
+            for(size_t i = block * GEN_BLOCK; i < end; i++) {
+                switch(dist) {
+                case Distribution::uniform:
+                    result[i] = T(gen());
+                    break;
+                case Distribution::sorted:
+                    result[i] = T(i);
+                    break;
+                case Distribution::reversed:
+                    result[i] = T(n - i);
+                    break;
+                case Distribution::sawtooth:
+                    result[i] = T(i % tooth);
+                    break;
+                case Distribution::few_unique:
+                    result[i] = T(gen() % FEW_UNIQUE_VALUES);
+                    break;
+                case Distribution::zipf: {
+                    size_t rank = std::lower_bound(cdf.begin(), cdf.end(), unit(gen)) - cdf.begin();
+                    //scatter the ranks over the key space so popular keys are not also the smallest ones
+                    result[i] = T(uint32_t(rank * 2654435761u));
+                    break;
+                }
+                }
+            }
+        }
+    });
+}
+
+//mixes a key into a well distributed 64-bit value, summing these gives an order independent checksum
+inline uint64_t mix_key(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+template <typename T>
+uint64_t parallel_checksum(const std::vector<T>& data) {
+    int n_threads = bench_threads();
+    std::vector<uint64_t> partial(n_threads, 0);
+    run_threads(n_threads, [&](int t) {
+        size_t start = data.size() * t / n_threads;
+        size_t end = data.size() * (t + 1) / n_threads;
+        uint64_t sum = 0;
+        for(size_t i = start; i < end; i++) {
+            sum += mix_key(uint64_t(data[i]));
+        }
+        partial[t] = sum;
+    });
+    uint64_t total = 0;
+    for(uint64_t s: partial) total += s;
+    return total;
+}
+
+template <typename T>
+bool parallel_is_sorted(const std::vector<T>& data) {
+    int n_threads = bench_threads();
+    std::vector<char> ok(n_threads, 1);
+    run_threads(n_threads, [&](int t) {
+        size_t start = data.size() * t / n_threads;
+        size_t end = data.size() * (t + 1) / n_threads;
+        //each block also checks the pair straddling its left boundary
+        for(size_t i = std::max<size_t>(start, 1); i < end; i++) {
+            if(data[i] < data[i-1]) {
+                ok[t] = 0;
+                return;
+            }
+        }
+    });
+    return std::all_of(ok.begin(), ok.end(), [](char c) { return c != 0; });
+}
+
+//percentile by linear interpolation between the two closest ranks at position p * (n - 1), as NumPy does by
+//default (R type 7), p in [0, 1]
+double percentile(std::vector<double> values, double p) {
+    std::sort(values.begin(), values.end());
+    double pos = p * (values.size() - 1);
+    size_t lo = size_t(pos);
+    size_t hi = std::min(lo + 1, values.size() - 1);
+    return values[lo] + (pos - lo) * (values[hi] - values[lo]);
+}
+
+template <typename T>
+struct SortAlgorithm {
+    std::string name;
+    std::function<void(std::vector<T>&)> run;
+    //the binary merge_sort is far slower than the rest, so it can be capped to keep runs short
+    size_t max_n;
+};
+
+template <typename T>
+std::vector<SortAlgorithm<T>> algorithms(size_t merge_sort_max_n) {
+    return {
+        {"merge_sort", [](std::vector<T>& v) { merge_sort(v, MergeMemory::buffered); }, merge_sort_max_n},
+        {"merge_sort_in_place", [](std::vector<T>& v) { merge_sort(v, MergeMemory::in_place); }, merge_sort_max_n},
+        {"multiway_merge_sort", [](std::vector<T>& v) { multiway_merge_sort(v); }, SIZE_MAX},
+        {"natural_merge_sort", [](std::vector<T>& v) { natural_merge_sort(v); }, SIZE_MAX},
+        {"sort_vector", [](std::vector<T>& v) { sort_vector(v); }, SIZE_MAX},
+        {"std_sort", [](std::vector<T>& v) { std::sort(v.begin(), v.end()); }, SIZE_MAX},
+    };
+}
+
+struct BenchConfig {
+    int max_magnitude;
+    int trials;
+    int warmups;
+    size_t merge_sort_max_n;
+};
+
+template <typename T>
+bool bench_distribution(std::ofstream& csv, const BenchConfig& config, Distribution dist, const std::string& dist_name) {
+    namespace chrn = std::chrono;
+    bool all_verified = true;
+
+    for(int magnitude = 1; magnitude <= config.max_magnitude; magnitude++) {
+        size_t n = 1;
+        for(int i = 0; i < magnitude; i++) n *= 10;
+
+        std::vector<T> input;
+        generate_data(input, n, dist);
+        uint64_t input_checksum = parallel_checksum(input);
+
+        for(const auto& algo: algorithms<T>(config.merge_sort_max_n)) {
+            if(n > algo.max_n) continue;
+
+            std::vector<double> times_ms;
+            bool verified = true;
+            std::vector<T> data;
+            for(int trial = 0; trial < config.warmups + config.trials; trial++) {
+                data = input;
+
+                auto start = chrn::steady_clock::now();
+                algo.run(data);
+                auto end = chrn::steady_clock::now();
+
+                if(!parallel_is_sorted(data) || parallel_checksum(data) != input_checksum) {
+                    verified = false;
+                }
+                if(trial >= config.warmups) {
+                    times_ms.push_back(chrn::duration<double, std::milli>(end - start).count());
+                }
+            }
+
+            double median = percentile(times_ms, 0.5);
+            std::cout << algo.name << " " << dist_name << " " << 8 * sizeof(T) << "-bit n=10^" << magnitude
+                      << ": median " << median << " ms" << (verified ? "" : "  NOT SORTED") << "\n";
+            csv << algo.name << "," << dist_name << "," << 8 * sizeof(T) << "," << n << "," << times_ms.size() << ","
+                << median << "," << percentile(times_ms, 0.1) << "," << percentile(times_ms, 0.9) << ","
+                << percentile(times_ms, 0.0) << "," << percentile(times_ms, 1.0) << ","
+                << median * 1e6 / n << "," << (verified ? 1 : 0) << "\n";
+            csv.flush();
+            all_verified = all_verified && verified;
+        }
+    }
+    return all_verified;
+}
+
+int main(int argc, char* argv[]) {
+    BenchConfig config;
+    config.max_magnitude = 7;
+    config.trials = 5;
+    config.warmups = 1;
+    config.merge_sort_max_n = 10000000;
+    std::string csv_path = "bench_results.csv";
+
+    try {
+        if(argc > 1) config.max_magnitude = std::stoi(argv[1]);
+        if(argc > 2) config.trials = std::stoi(argv[2]);
+        if(argc > 3) config.warmups = std::stoi(argv[3]);
+        if(argc > 4) csv_path = argv[4];
+    } catch (const std::exception& e) {
+        std::cerr << "Usage: " << argv[0] << " [max_magnitude] [trials] [warmups] [csv_path]\n";
+        return 1;
+    }
+    if(config.trials < 1) config.trials = 1;
+
+    std::ofstream csv(csv_path);
+    csv << "algorithm,distribution,key_bits,n,trials,median_ms,p10_ms,p90_ms,min_ms,max_ms,ns_per_element,verified\n";
+
+    bool all_verified = true;
+    for(const auto& dist: DISTRIBUTIONS) {
+        all_verified = bench_distribution<int>(csv, config, dist.first, dist.second) && all_verified;
+    }
+    //64-bit keys, uniformly distributed over the whole key space
+    all_verified = bench_distribution<uint64_t>(csv, config, Distribution::uniform, "uniform_64bit") && all_verified;
+
+    csv.close();
+
+    if(!all_verified) {
+        std::cerr << "Some sorts produced unsorted output or lost keys, see the verified column in " << csv_path << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <numeric>
+#include <type_traits>
+#include <stdexcept>
+
+#include "mergesort.h"
+#include "radix_sort.h"
+
+// Sort front-end. The choice of engine is made at compile time from the key type:
+// integral and float/double keys go to the parallel radix sort, everything else to merge_sort.
+// n_threads = 0 uses every hardware thread
+
+template <typename T>
+void sort_vector(std::vector<T>& data, int n_threads = 0) {
+    if constexpr (radix_sortable_v<T>) {
+        radix_sort(data, n_threads);
+    } else {
+        merge_sort(data);
+    }
+}
+
+template <typename K, typename V>
+struct KeyValue {
+    K key;
+    V value;
+
+    //merge_sort only needs <=, and comparing keys alone keeps equal keys in their original order
+    bool operator<=(const KeyValue& other) const {
+        return key <= other.key;
+    }
+};
+
+// Sorts keys and reorders values the same way. Stable, so equal keys keep their relative order.
+// Throws std::invalid_argument unless there is exactly one value per key
+template <typename K, typename V>
+void sort_by_key(std::vector<K>& keys, std::vector<V>& values, int n_threads = 0) {
+    if(values.size() != keys.size()) {
+        throw std::invalid_argument("sort_by_key needs one value per key");
+    }
+    std::vector<KeyValue<K, V>> pairs(keys.size());
+    for(size_t i = 0; i < keys.size(); i++) {
+        pairs[i] = {keys[i], values[i]};
+    }
+
+    if constexpr (radix_sortable_v<K>) {
+        radix_sort_by(pairs, [](const KeyValue<K, V>& kv) { return radix_encode(kv.key); }, n_threads);
+    } else {
+        merge_sort(pairs);
+    }
+
+    for(size_t i = 0; i < keys.size(); i++) {
+        keys[i] = pairs[i].key;
+        values[i] = pairs[i].value;
+    }
+}
+
+// Returns the indices that would sort keys, without reordering keys
+template <typename K>
+std::vector<size_t> argsort(const std::vector<K>& keys, int n_threads = 0) {
+    std::vector<K> sorted_keys = keys;
+    std::vector<size_t> indices(keys.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    sort_by_key(sorted_keys, indices, n_threads);
+    return indices;
+}
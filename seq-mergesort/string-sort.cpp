@@ -0,0 +1,113 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <algorithm>
+
+#include "string_sort.h"
+
+// Sorts, deduplicates and diffs the node names in crawler output files.
+// Understands both output formats: "- name" lines from the level crawlers, and the indented
+// "name, depth=d, num children=c" tree lines from seq-graphcrawler. Other lines (counts, timings) are skipped
+
+//returns false if the line does not hold a node name
+bool extract_name(std::string_view line, std::string_view& name) {
+    size_t start = line.find_first_not_of(" \t");
+    if(start == std::string_view::npos) return false;
+    line.remove_prefix(start);
+
+    if(line.rfind("- ", 0) == 0) {
+        name = line.substr(2);
+        return true;
+    }
+    size_t depth_pos = line.rfind(", depth=");
+    if(depth_pos != std::string_view::npos) {
+        name = line.substr(0, depth_pos);
+        return true;
+    }
+    return false;
+}
+
+bool read_names(const std::string& path, StringArena& arena, std::vector<StringKey>& keys) {
+    std::ifstream file(path);
+    if(!file) {
+        std::cerr << "Could not open " << path << "\n";
+        return false;
+    }
+    std::string line;
+    std::string_view name;
+    while(std::getline(file, line)) {
+        if(extract_name(line, name)) {
+            keys.push_back(make_key(arena.add(name)));
+        }
+    }
+    return true;
+}
+
+double sort_unique(std::vector<StringKey>& keys) {
+    namespace chrn = std::chrono;
+    std::vector<uint32_t> lcps;
+    auto start = chrn::steady_clock::now();
+    string_sort(keys, lcps);
+    unique_sorted(keys, lcps);
+    auto end = chrn::steady_clock::now();
+    return chrn::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    if(argc < 2 || argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " <crawl_output> [other_crawl_output]\n";
+        std::cerr << "With one file, prints its distinct node names in sorted order.\n";
+        std::cerr << "With two files, prints names only in the first (\"< name\") or only in the second (\"> name\").\n";
+        return 1;
+    }
+
+    StringArena arena;
+    std::vector<StringKey> a;
+    if(!read_names(argv[1], arena, a)) return 1;
+    size_t a_lines = a.size();
+
+    //compare against sorting the same names as std::strings
+    std::vector<std::string> baseline;
+    for(const StringKey& key: a) baseline.emplace_back(key.view());
+    auto base_start = std::chrono::steady_clock::now();
+    std::sort(baseline.begin(), baseline.end());
+    baseline.erase(std::unique(baseline.begin(), baseline.end()), baseline.end());
+    auto base_end = std::chrono::steady_clock::now();
+
+    double sort_ms = sort_unique(a);
+    std::cerr << argv[1] << ": " << a_lines << " names, " << a.size() << " distinct, sorted in " << sort_ms << " ms"
+              << " (std::sort of std::string: " << std::chrono::duration<double, std::milli>(base_end - base_start).count() << " ms)\n";
+
+    if(argc == 2) {
+        for(const StringKey& key: a) {
+            std::cout << key.view() << "\n";
+        }
+        return 0;
+    }
+
+    std::vector<StringKey> b;
+    if(!read_names(argv[2], arena, b)) return 1;
+    size_t b_lines = b.size();
+    sort_ms = sort_unique(b);
+    std::cerr << argv[2] << ": " << b_lines << " names, " << b.size() << " distinct, sorted in " << sort_ms << " ms\n";
+
+    //merge-style diff of the two sorted distinct lists
+    size_t i = 0;
+    size_t j = 0;
+    uint32_t lcp;
+    while(i < a.size() || j < b.size()) {
+        int order = (i == a.size()) ? 1 : (j == b.size()) ? -1 : compare_from(a[i], b[j], 0, lcp);
+        if(order < 0) {
+            std::cout << "< " << a[i++].view() << "\n";
+        } else if(order > 0) {
+            std::cout << "> " << b[j++].view() << "\n";
+        } else {
+            i++;
+            j++;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+
+// String sort for the crawler outputs (hundreds of thousands of actor and movie names).
+// Each key is the first 8 bytes of the string packed big-endian into an integer, plus a pointer and length,
+// so most comparisons are one integer compare and never touch the string bytes. The sort is an LCP-aware
+// mergesort: every key carries the length of the prefix it shares with the key before it, which lets the
+// merge skip bytes that are already known to be equal. The bytes live in a StringArena, and sorting only
+// moves the small fixed-size keys, never std::string objects
+
+const size_t ARENA_BLOCK_BYTES = 1 << 20;
+
+// Append-only storage for string bytes. Strings never move once added, so keys can point into it
+class StringArena {
+    std::vector<std::unique_ptr<char[]>> blocks;
+    size_t block_used = 0;
+    size_t block_size = 0;
+
+    public:
+
+    std::string_view add(std::string_view s) {
+        if(blocks.empty() || block_used + s.size() > block_size) {
+            //strings larger than a block get a block of their own
+            block_size = std::max(ARENA_BLOCK_BYTES, s.size());
+            blocks.push_back(std::make_unique<char[]>(block_size));
+            block_used = 0;
+        }
+        char* dst = blocks.back().get() + block_used;
+        std::memcpy(dst, s.data(), s.size());
+        block_used += s.size();
+        return std::string_view(dst, s.size());
+    }
+};
+
+struct StringKey {
+    //first 8 bytes, big-endian and zero padded, so integer order is byte order
+    uint64_t prefix;
+    const char* chars;
+    uint32_t length;
+
+    std::string_view view() const {
+        return std::string_view(chars, length);
+    }
+};
+
+inline StringKey make_key(std::string_view s) {
+    StringKey key;
+    key.prefix = 0;
+    size_t n = std::min<size_t>(s.size(), 8);
+    for(size_t i = 0; i < n; i++) {
+        key.prefix |= uint64_t(uint8_t(s[i])) << (56 - 8 * i);
+    }
+    key.chars = s.data();
+    key.length = uint32_t(s.size());
+    return key;
+}
+
+// Three-way compare of a and b, given that their first h bytes are already known to be equal.
+// Sets lcp to the length of their common prefix. Returns <0, 0 or >0
+inline int compare_from(const StringKey& a, const StringKey& b, uint32_t h, uint32_t& lcp) {
+    if(h < 8) {
+        uint64_t diff = a.prefix ^ b.prefix;
+        if(diff != 0) {
+            //the padding can make a string look longer than it is, e.g. "a" against "a\0b"
+            lcp = std::min<uint32_t>(__builtin_clzll(diff) / 8, std::min(a.length, b.length));
+            return int(a.prefix > b.prefix) - int(a.prefix < b.prefix);
+        }
+        //equal prefixes and one string ends within them: the shorter one is a prefix of the longer one
+        if(a.length <= 8 || b.length <= 8) {
+            lcp = std::min(a.length, b.length);
+            return int(a.length > b.length) - int(a.length < b.length);
+        }
+        h = 8;
+    }
+
+    uint32_t n = std::min(a.length, b.length);
+    uint32_t i = h;
+    while(i < n && a.chars[i] == b.chars[i]) i++;
+    lcp = i;
+    if(i < n) {
+        return int(uint8_t(a.chars[i]) > uint8_t(b.chars[i])) - int(uint8_t(a.chars[i]) < uint8_t(b.chars[i]));
+    }
+    return int(a.length > b.length) - int(a.length < b.length);
+}
+
+class StringSorter {
+    std::vector<StringKey> tmp_keys;
+    std::vector<uint32_t> tmp_lcps;
+
+    //insertion sort for small ranges, then fill in the lcps of neighbours
+    void sort_small(StringKey* keys, uint32_t* lcps, size_t n) {
+        uint32_t unused;
+        for(size_t i = 1; i < n; i++) {
+            StringKey key = keys[i];
+            size_t j = i;
+            while(j > 0 && compare_from(key, keys[j-1], 0, unused) < 0) {
+                keys[j] = keys[j-1];
+                j--;
+            }
+            keys[j] = key;
+        }
+        lcps[0] = 0;
+        for(size_t i = 1; i < n; i++) {
+            compare_from(keys[i-1], keys[i], 0, lcps[i]);
+        }
+    }
+
+    // Merges the sorted runs a and b (each with lcps relative to its predecessor) into out.
+    // ha and hb are the lcps of each run's head with the last key written. Whichever head shares the longer
+    // prefix with the last output is the smaller one, so only ties need a real comparison, and that comparison
+    // starts after the shared prefix
+    void lcp_merge(const StringKey* a, const uint32_t* a_lcps, size_t na,
+                   const StringKey* b, const uint32_t* b_lcps, size_t nb,
+                   StringKey* out, uint32_t* out_lcps) {
+        size_t i = 0;
+        size_t j = 0;
+        size_t k = 0;
+        uint32_t ha = 0;
+        uint32_t hb = 0;
+
+        while(i < na && j < nb) {
+            if(ha > hb) {
+                out[k] = a[i];
+                out_lcps[k++] = ha;
+                i++;
+                if(i < na) ha = a_lcps[i];
+            } else if(hb > ha) {
+                out[k] = b[j];
+                out_lcps[k++] = hb;
+                j++;
+                if(j < nb) hb = b_lcps[j];
+            } else {
+                uint32_t lcp;
+                //ties go to a so the sort is stable
+                if(compare_from(a[i], b[j], ha, lcp) <= 0) {
+                    out[k] = a[i];
+                    out_lcps[k++] = ha;
+                    i++;
+                    if(i < na) ha = a_lcps[i];
+                    hb = lcp;
+                } else {
+                    out[k] = b[j];
+                    out_lcps[k++] = hb;
+                    j++;
+                    if(j < nb) hb = b_lcps[j];
+                    ha = lcp;
+                }
+            }
+        }
+
+        //the first leftover key's lcp is with the last key written, the rest keep their own
+        if(i < na) {
+            out[k] = a[i];
+            out_lcps[k++] = ha;
+            for(i++; i < na; i++) {
+                out[k] = a[i];
+                out_lcps[k++] = a_lcps[i];
+            }
+        }
+        if(j < nb) {
+            out[k] = b[j];
+            out_lcps[k++] = hb;
+            for(j++; j < nb; j++) {
+                out[k] = b[j];
+                out_lcps[k++] = b_lcps[j];
+            }
+        }
+    }
+
+    void sort_range(StringKey* keys, uint32_t* lcps, size_t first, size_t last) {
+        const size_t INSERTION_CUTOFF = 16;
+        size_t n = last - first;
+        if(n <= INSERTION_CUTOFF) {
+            sort_small(keys + first, lcps + first, n);
+            return;
+        }
+
+        size_t mid = first + n / 2;
+        sort_range(keys, lcps, first, mid);
+        sort_range(keys, lcps, mid, last);
+        lcp_merge(keys + first, lcps + first, mid - first, keys + mid, lcps + mid, last - mid,
+                  tmp_keys.data() + first, tmp_lcps.data() + first);
+        std::copy(tmp_keys.begin() + first, tmp_keys.begin() + last, keys + first);
+        std::copy(tmp_lcps.begin() + first, tmp_lcps.begin() + last, lcps + first);
+    }
+
+    public:
+
+    // Stable sort of keys. On return lcps[i] is the length of the common prefix of keys[i-1] and keys[i]
+    void sort(std::vector<StringKey>& keys, std::vector<uint32_t>& lcps) {
+        lcps.assign(keys.size(), 0);
+        if(keys.size() < 2) return;
+        tmp_keys.resize(keys.size());
+        tmp_lcps.resize(keys.size());
+        sort_range(keys.data(), lcps.data(), 0, keys.size());
+    }
+};
+
+inline void string_sort(std::vector<StringKey>& keys, std::vector<uint32_t>& lcps) {
+    StringSorter sorter;
+    sorter.sort(keys, lcps);
+}
+
+// Removes adjacent duplicates from sorted keys. Uses the lcps from string_sort, so no string is reread:
+// a key equals the one before it exactly when their lcp covers both of them
+inline void unique_sorted(std::vector<StringKey>& keys, std::vector<uint32_t>& lcps) {
+    size_t kept = 0;
+    for(size_t i = 0; i < keys.size(); i++) {
+        bool duplicate = kept > 0 && lcps[i] == keys[i].length && keys[i].length == keys[kept-1].length;
+        if(duplicate) {
+            //the next key's lcp with the removed one equals its lcp with the kept copy, so nothing to fix
+            continue;
+        }
+        keys[kept] = keys[i];
+        lcps[kept] = lcps[i];
+        kept++;
+    }
+    keys.resize(kept);
+    lcps.resize(kept);
+}